@@ -0,0 +1,368 @@
+// Steady-state heap allocation check.
+//
+// Replaces the global allocation functions (malloc & co, which operator new
+// uses as well) with counting versions. After a warm-up, N messages are
+// published with Publisher::send and received by a Subscriber callback, one at
+// a time, so every message passes the complete publish/receive path. All heap
+// allocations of all threads during that window are counted.
+//
+// The process exits with 1 if any callback mode performs more allocations per
+// message than --max-allocations-per-message, so it can be used as a guard
+// against new allocations on the hot path. The default of 2 accepts exactly
+// the allocations the path cannot avoid today, the shared_ptr control blocks
+// of the publisher's and the subscriber's buffer (recycle::shared_pool
+// allocates one for every buffer it hands out). Any other allocation fails
+// the check.
+//
+// --backtrace=N prints the call stacks of the first N counted allocations.
+//
+// Usage:
+//   stps_alloc_check [--modes=sync,async] [--threads=1] [--size=256]
+//                    [--warmup=1000] [--messages=10000]
+//                    [--max-allocations-per-message=2] [--backtrace=0]
+//                    [--verbose]
+//
+// Only glibc is supported (the replacements forward to __libc_malloc & co).
+
+#include <stps/executor/executor.h>
+#include <stps/publisher/publisher.h>
+#include <stps/subscriber/subscriber.h>
+
+#include <execinfo.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace
+{
+
+constexpr size_t kMaxBacktraces = 64;
+
+// See the top of the file
+constexpr double kKnownAllocationsPerMessage = 2.0;
+constexpr int kMaxBacktraceDepth = 32;
+
+struct AllocationCounters
+{
+    std::atomic<bool> counting{false};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+
+    std::atomic<size_t> backtraces_requested{0};
+    std::atomic<size_t> backtraces_taken{0};
+    void* backtrace_frames[kMaxBacktraces][kMaxBacktraceDepth];
+    int backtrace_depth[kMaxBacktraces];
+    size_t backtrace_size[kMaxBacktraces];
+};
+
+// Zero-initialized before any allocation can happen
+AllocationCounters counters;
+
+// backtrace() may allocate itself
+thread_local bool in_allocation_hook = false;
+
+void countAllocation(size_t size)
+{
+    if (!counters.counting.load(std::memory_order_relaxed) || in_allocation_hook)
+        return;
+
+    in_allocation_hook = true;
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (counters.backtraces_taken.load(std::memory_order_relaxed) < counters.backtraces_requested.load(std::memory_order_relaxed))
+    {
+        const size_t index = counters.backtraces_taken.fetch_add(1, std::memory_order_relaxed);
+        if (index < std::min(kMaxBacktraces, counters.backtraces_requested.load(std::memory_order_relaxed)))
+        {
+            counters.backtrace_depth[index] = backtrace(counters.backtrace_frames[index], kMaxBacktraceDepth);
+            counters.backtrace_size[index] = size;
+        }
+    }
+    in_allocation_hook = false;
+}
+
+} // namespace
+
+extern "C"
+{
+
+void* malloc(size_t size)
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    countAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    countAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    countAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+    countAllocation(size);
+    *pointer = __libc_memalign(alignment, size);
+    return (*pointer ? 0 : ENOMEM);
+}
+
+} // extern "C"
+
+namespace
+{
+
+struct Options
+{
+    std::vector<std::string> modes{"sync", "async"};
+    size_t thread_count = 1;
+    size_t message_size = 256;
+    size_t warmup_count = 1000;
+    size_t message_count = 10000;
+    double max_allocations_per_message = kKnownAllocationsPerMessage;
+    size_t backtrace_count = 0;
+    bool verbose = false;
+};
+
+struct RunResult
+{
+    bool completed = false;
+    uint64_t messages = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+std::vector<std::string> splitList(const std::string& value)
+{
+    std::vector<std::string> list;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+            list.push_back(item);
+    }
+    return list;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const size_t equal_pos = arg.find('=');
+        const std::string key = arg.substr(0, equal_pos);
+        const std::string value = (equal_pos == std::string::npos ? "" : arg.substr(equal_pos + 1));
+
+        if (key == "--modes")
+            options.modes = splitList(value);
+        else if (key == "--threads")
+            options.thread_count = std::stoull(value);
+        else if (key == "--size")
+            options.message_size = std::stoull(value);
+        else if (key == "--warmup")
+            options.warmup_count = std::stoull(value);
+        else if (key == "--messages")
+            options.message_count = std::stoull(value);
+        else if (key == "--max-allocations-per-message")
+            options.max_allocations_per_message = std::stod(value);
+        else if (key == "--backtrace")
+            options.backtrace_count = std::min(std::stoull(value), static_cast<unsigned long long>(kMaxBacktraces));
+        else if (key == "--verbose")
+            options.verbose = true;
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sends a message and spins until the subscriber has received it. Nothing in
+// here allocates.
+bool sendAndWait(const stps::Publisher& publisher, std::vector<char>& payload,
+        const std::atomic<uint64_t>& received_messages, uint64_t sequence_number)
+{
+    std::memcpy(payload.data(), &sequence_number, sizeof(sequence_number));
+    publisher.send(payload.data(), payload.size());
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (received_messages.load(std::memory_order_acquire) <= sequence_number)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+RunResult runCheck(bool synchronous, const Options& options)
+{
+    RunResult result;
+    auto executor = std::make_shared<stps::Executor>(options.thread_count);
+    stps::Publisher publisher(executor, "127.0.0.1", 0);
+
+    std::atomic<uint64_t> received_messages{0};
+    stps::Subscriber subscriber(executor);
+    subscriber.setCallback(
+            [&received_messages](const stps::CallbackData& callback_data)
+            {
+                uint64_t sequence_number = 0;
+                std::memcpy(&sequence_number, callback_data.buffer_->data(), sizeof(sequence_number));
+                received_messages.store(sequence_number + 1, std::memory_order_release);
+            }, synchronous);
+    subscriber.addSession("127.0.0.1", publisher.getPort());
+
+    const auto connect_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (publisher.getSubscriberCount() < 1)
+    {
+        if (std::chrono::steady_clock::now() > connect_deadline)
+        {
+            std::cerr << "Subscriber did not connect" << std::endl;
+            return result;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // Give the handshake time to complete
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<char> payload(std::max(options.message_size, sizeof(uint64_t)));
+
+    uint64_t sequence_number = 0;
+    for (; sequence_number < options.warmup_count; ++sequence_number)
+    {
+        if (!sendAndWait(publisher, payload, received_messages, sequence_number))
+        {
+            std::cerr << "Message " << sequence_number << " was not received during warm up" << std::endl;
+            return result;
+        }
+    }
+
+    counters.allocations = 0;
+    counters.bytes = 0;
+    counters.backtraces_taken = 0;
+    counters.backtraces_requested = options.backtrace_count;
+    counters.counting = true;
+
+    bool completed = true;
+    for (; sequence_number < options.warmup_count + options.message_count; ++sequence_number)
+    {
+        if (!sendAndWait(publisher, payload, received_messages, sequence_number))
+        {
+            completed = false;
+            break;
+        }
+    }
+
+    counters.counting = false;
+
+    result.completed = completed;
+    result.messages = sequence_number - options.warmup_count;
+    result.allocations = counters.allocations;
+    result.bytes = counters.bytes;
+
+    subscriber.cancel();
+    publisher.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return result;
+}
+
+void printBacktraces()
+{
+    const size_t count = std::min({counters.backtraces_taken.load(),
+            counters.backtraces_requested.load(), kMaxBacktraces});
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::cout << "Allocation " << i << " (" << counters.backtrace_size[i] << " bytes):" << std::endl;
+        backtrace_symbols_fd(counters.backtrace_frames[i], counters.backtrace_depth[i], STDOUT_FILENO);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    // Load the unwinder now, its first use allocates
+    void* frames[1];
+    backtrace(frames, 1);
+
+    // The library logs to std::cout. Silence it unless --verbose is given.
+    std::streambuf* result_buffer = std::cout.rdbuf();
+    if (!options.verbose)
+        std::cout.rdbuf(nullptr);
+
+    bool passed = true;
+    bool header_printed = false;
+    for (const auto& mode : options.modes)
+    {
+        const RunResult result = runCheck(mode == "sync", options);
+
+        const double allocations_per_message = (result.messages > 0
+                ? static_cast<double>(result.allocations) / result.messages : 0.0);
+        const double bytes_per_message = (result.messages > 0
+                ? static_cast<double>(result.bytes) / result.messages : 0.0);
+        const bool mode_passed = result.completed && (result.messages > 0)
+            && (allocations_per_message <= options.max_allocations_per_message);
+        passed = passed && mode_passed;
+
+        std::streambuf* log_buffer = std::cout.rdbuf(result_buffer);
+        std::cout.clear();
+        if (!header_printed)
+        {
+            std::cout << "callback,threads,size,messages,allocations,bytes,allocations_per_msg,bytes_per_msg,result\n";
+            header_printed = true;
+        }
+        std::cout << mode << "," << options.thread_count << "," << options.message_size << ","
+            << result.messages << "," << result.allocations << "," << result.bytes << ","
+            << allocations_per_message << "," << bytes_per_message << ","
+            << (mode_passed ? "PASS" : (result.completed ? "FAIL" : "INCOMPLETE")) << std::endl;
+        if (!mode_passed)
+            printBacktraces();
+        std::cout.rdbuf(log_buffer);
+    }
+
+    std::cout.rdbuf(result_buffer);
+    std::cout.clear();
+    return (passed ? 0 : 1);
+}
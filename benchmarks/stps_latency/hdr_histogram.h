@@ -0,0 +1,238 @@
+#pragma once
+
+// Minimal HDR histogram (log-linear buckets with a fixed number of significant
+// decimal digits), following the layout of HdrHistogram so that the percentile
+// output can be fed to the usual HdrHistogram plotting tools.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+class HdrHistogram
+{
+    public:
+        HdrHistogram(uint64_t highest_trackable_value, int significant_digits = 3)
+        {
+            const uint64_t largest_value_with_single_unit_resolution =
+                2 * static_cast<uint64_t>(std::pow(10, significant_digits));
+            int sub_bucket_count_magnitude = 0;
+            while ((uint64_t(1) << sub_bucket_count_magnitude) < largest_value_with_single_unit_resolution)
+                ++sub_bucket_count_magnitude;
+
+            sub_bucket_half_count_magnitude_ = std::max(sub_bucket_count_magnitude, 1) - 1;
+            sub_bucket_count_ = uint64_t(1) << (sub_bucket_half_count_magnitude_ + 1);
+            sub_bucket_half_count_ = sub_bucket_count_ / 2;
+            sub_bucket_mask_ = sub_bucket_count_ - 1;
+
+            bucket_count_ = 1;
+            uint64_t smallest_untrackable_value = sub_bucket_count_;
+            while (smallest_untrackable_value <= highest_trackable_value)
+            {
+                if (smallest_untrackable_value > (UINT64_MAX / 2))
+                {
+                    ++bucket_count_;
+                    break;
+                }
+                smallest_untrackable_value <<= 1;
+                ++bucket_count_;
+            }
+
+            counts_.resize((bucket_count_ + 1) * sub_bucket_half_count_, 0);
+            highest_trackable_value_ = highest_trackable_value;
+        }
+
+        void record(uint64_t value, uint64_t count = 1)
+        {
+            value = std::min(value, highest_trackable_value_);
+            counts_[countsIndex(value)] += count;
+            total_count_ += count;
+            min_ = std::min(min_, value);
+            max_ = std::max(max_, value);
+        }
+
+        // Coordinated omission correction: a sample that took longer than the
+        // expected interval between samples hid the samples that should have
+        // been taken in the meantime. Those are back-filled with linearly
+        // decreasing values.
+        void recordCorrected(uint64_t value, uint64_t expected_interval)
+        {
+            record(value);
+            if ((expected_interval == 0) || (value <= expected_interval))
+                return;
+
+            for (uint64_t missing_value = value - expected_interval;
+                    missing_value >= expected_interval;
+                    missing_value -= expected_interval)
+            {
+                record(missing_value);
+            }
+        }
+
+        uint64_t totalCount() const { return total_count_; }
+        uint64_t min() const { return (total_count_ > 0 ? min_ : 0); }
+        uint64_t max() const { return max_; }
+
+        double mean() const
+        {
+            if (total_count_ == 0)
+                return 0.0;
+            double sum = 0.0;
+            for (size_t i = 0; i < counts_.size(); ++i)
+                sum += static_cast<double>(counts_[i]) * medianEquivalentValue(valueFromIndex(i));
+            return sum / total_count_;
+        }
+
+        double stdDeviation() const
+        {
+            if (total_count_ == 0)
+                return 0.0;
+            const double mean_value = mean();
+            double geometric_deviation_total = 0.0;
+            for (size_t i = 0; i < counts_.size(); ++i)
+            {
+                const double deviation = medianEquivalentValue(valueFromIndex(i)) - mean_value;
+                geometric_deviation_total += deviation * deviation * counts_[i];
+            }
+            return std::sqrt(geometric_deviation_total / total_count_);
+        }
+
+        uint64_t valueAtPercentile(double percentile) const
+        {
+            const double requested_percentile = std::min(percentile, 100.0);
+            uint64_t count_at_percentile =
+                static_cast<uint64_t>(std::ceil(requested_percentile / 100.0 * total_count_));
+            count_at_percentile = std::max(count_at_percentile, uint64_t(1));
+
+            uint64_t running_count = 0;
+            for (size_t i = 0; i < counts_.size(); ++i)
+            {
+                running_count += counts_[i];
+                if (running_count >= count_at_percentile)
+                    return std::min(highestEquivalentValue(valueFromIndex(i)), max_);
+            }
+            return 0;
+        }
+
+        // Writes the classic HdrHistogram percentile distribution (.hgrm).
+        // Values are divided by value_unit_ratio, e.g. 1000.0 for ns -> us.
+        void outputPercentileDistribution(std::ostream& out, double value_unit_ratio,
+                int ticks_per_half_distance = 5) const
+        {
+            out << std::setw(12) << "Value" << " " << std::setw(14) << "Percentile" << " "
+                << std::setw(10) << "TotalCount" << " " << std::setw(14) << "1/(1-Percentile)"
+                << "\n\n" << std::fixed;
+
+            if (total_count_ > 0)
+            {
+                double percentile = 0.0;
+                for (;;)
+                {
+                    const uint64_t value = valueAtPercentile(percentile);
+                    out << std::setw(12) << std::setprecision(3) << value / value_unit_ratio << " "
+                        << std::setw(14) << std::setprecision(12) << percentile / 100.0 << " "
+                        << std::setw(10) << countAtOrBelow(value) << " ";
+                    if (percentile < 100.0)
+                        out << std::setw(14) << std::setprecision(2) << 1.0 / (1.0 - percentile / 100.0) << "\n";
+                    else
+                        out << std::setw(14) << "inf" << "\n";
+
+                    if ((percentile >= 100.0) || (value >= max_))
+                    {
+                        if (percentile < 100.0)
+                            out << std::setw(12) << std::setprecision(3) << max_ / value_unit_ratio << " "
+                                << std::setw(14) << std::setprecision(12) << 1.0 << " "
+                                << std::setw(10) << total_count_ << " " << std::setw(14) << "inf\n";
+                        break;
+                    }
+
+                    // Ticks get twice as dense with every halving of the
+                    // remaining distance to 100%
+                    const double remaining = 100.0 - percentile;
+                    const double half_distance =
+                        std::pow(2.0, std::floor(std::log2(100.0 / remaining)) + 1.0);
+                    percentile += 100.0 / (half_distance * ticks_per_half_distance);
+                }
+            }
+
+            out << std::setprecision(3)
+                << "#[Mean    = " << std::setw(12) << mean() / value_unit_ratio
+                << ", StdDeviation   = " << std::setw(12) << stdDeviation() / value_unit_ratio << "]\n"
+                << "#[Max     = " << std::setw(12) << max_ / value_unit_ratio
+                << ", Total count    = " << std::setw(12) << total_count_ << "]\n"
+                << "#[Buckets = " << std::setw(12) << bucket_count_
+                << ", SubBuckets     = " << std::setw(12) << sub_bucket_count_ << "]\n";
+            out.unsetf(std::ios::floatfield);
+        }
+
+    private:
+        int bucketIndex(uint64_t value) const
+        {
+            const int pow2_ceiling = 64 - __builtin_clzll(value | sub_bucket_mask_);
+            return pow2_ceiling - (sub_bucket_half_count_magnitude_ + 1);
+        }
+
+        size_t countsIndex(uint64_t value) const
+        {
+            const int bucket_index = bucketIndex(value);
+            const uint64_t sub_bucket_index = value >> bucket_index;
+            const size_t bucket_base_index = static_cast<size_t>(bucket_index + 1) << sub_bucket_half_count_magnitude_;
+            return bucket_base_index + sub_bucket_index - sub_bucket_half_count_;
+        }
+
+        uint64_t valueFromIndex(size_t index) const
+        {
+            int bucket_index = static_cast<int>(index >> sub_bucket_half_count_magnitude_) - 1;
+            uint64_t sub_bucket_index = (index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+            if (bucket_index < 0)
+            {
+                sub_bucket_index -= sub_bucket_half_count_;
+                bucket_index = 0;
+            }
+            return sub_bucket_index << bucket_index;
+        }
+
+        uint64_t sizeOfEquivalentValueRange(uint64_t value) const
+        {
+            const int bucket_index = bucketIndex(value);
+            const uint64_t sub_bucket_index = value >> bucket_index;
+            const int adjusted_bucket = (sub_bucket_index >= sub_bucket_count_) ? bucket_index + 1 : bucket_index;
+            return uint64_t(1) << adjusted_bucket;
+        }
+
+        uint64_t highestEquivalentValue(uint64_t value) const
+        {
+            const uint64_t range = sizeOfEquivalentValueRange(value);
+            return (value & ~(range - 1)) + range - 1;
+        }
+
+        double medianEquivalentValue(uint64_t value) const
+        {
+            const uint64_t range = sizeOfEquivalentValueRange(value);
+            return static_cast<double>(value & ~(range - 1)) + static_cast<double>(range) / 2.0;
+        }
+
+        uint64_t countAtOrBelow(uint64_t value) const
+        {
+            const size_t target_index = countsIndex(std::min(value, highest_trackable_value_));
+            uint64_t running_count = 0;
+            for (size_t i = 0; i <= target_index && i < counts_.size(); ++i)
+                running_count += counts_[i];
+            return running_count;
+        }
+
+        int sub_bucket_half_count_magnitude_ = 0;
+        uint64_t sub_bucket_count_ = 0;
+        uint64_t sub_bucket_half_count_ = 0;
+        uint64_t sub_bucket_mask_ = 0;
+        int bucket_count_ = 0;
+        uint64_t highest_trackable_value_ = 0;
+
+        std::vector<uint64_t> counts_;
+        uint64_t total_count_ = 0;
+        uint64_t min_ = UINT64_MAX;
+        uint64_t max_ = 0;
+};
@@ -0,0 +1,380 @@
+// Latency benchmark.
+//
+// pingpong: Round trip between two Publisher/Subscriber pairs. The pinger
+//           publishes a ping, the ponger's callback publishes it back and the
+//           pinger measures the time until the pong arrives.
+// oneway:   A publisher stamps every message with the steady clock and the
+//           subscriber callback measures the difference. Both ends live in
+//           this process, so they share the clock.
+//
+// Every test runs for every callback mode (synchronous / asynchronous
+// Subscriber::setCallback) and executor thread count. Latencies are recorded
+// into HDR histograms, raw and corrected for coordinated omission using the
+// publish interval. A CSV summary goes to stdout; --hgrm-prefix additionally
+// writes the corrected percentile distribution of every run to a .hgrm file.
+// --trace-prefix writes a Chrome trace of every run (only if the library is
+// built with STPS_ENABLE_TRACING).
+//
+// Usage:
+//   stps_latency [--tests=pingpong,oneway] [--modes=sync,async]
+//                [--threads=1,2,4] [--rate=1000] [--count=10000]
+//                [--size=64] [--hgrm-prefix=PATH] [--trace-prefix=PATH]
+//                [--verbose]
+//
+// A rate of 0 sends back to back (no coordinated omission correction).
+
+#include "hdr_histogram.h"
+
+#include <stps/executor/executor.h>
+#include <stps/publisher/publisher.h>
+#include <stps/subscriber/subscriber.h>
+#include <stps/tracing/tracing.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr uint64_t kHighestTrackableLatencyNs = 60ull * 1000 * 1000 * 1000;
+
+struct Options
+{
+    std::vector<std::string> tests{"pingpong", "oneway"};
+    std::vector<std::string> modes{"sync", "async"};
+    std::vector<size_t> thread_counts{1, 2, 4};
+    size_t rate = 1000;
+    size_t count = 10000;
+    size_t message_size = 64;
+    std::string hgrm_prefix;
+    std::string trace_prefix;
+    bool verbose = false;
+};
+
+struct MessageStamp
+{
+    uint64_t sequence_number;
+    int64_t send_time_ns;
+};
+
+struct RunResult
+{
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    HdrHistogram raw{kHighestTrackableLatencyNs};
+    HdrHistogram corrected{kHighestTrackableLatencyNs};
+};
+
+std::vector<std::string> splitList(const std::string& value)
+{
+    std::vector<std::string> list;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+            list.push_back(item);
+    }
+    return list;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const size_t equal_pos = arg.find('=');
+        const std::string key = arg.substr(0, equal_pos);
+        const std::string value = (equal_pos == std::string::npos ? "" : arg.substr(equal_pos + 1));
+
+        if (key == "--tests")
+            options.tests = splitList(value);
+        else if (key == "--modes")
+            options.modes = splitList(value);
+        else if (key == "--threads")
+        {
+            options.thread_counts.clear();
+            for (const auto& item : splitList(value))
+                options.thread_counts.push_back(std::stoull(item));
+        }
+        else if (key == "--rate")
+            options.rate = std::stoull(value);
+        else if (key == "--count")
+            options.count = std::stoull(value);
+        else if (key == "--size")
+            options.message_size = std::stoull(value);
+        else if (key == "--hgrm-prefix")
+            options.hgrm_prefix = value;
+        else if (key == "--trace-prefix")
+            options.trace_prefix = value;
+        else if (key == "--verbose")
+            options.verbose = true;
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MessageStamp readStamp(const stps::CallbackData& callback_data)
+{
+    MessageStamp stamp{};
+    std::memcpy(&stamp, callback_data.buffer_->data(),
+            std::min(sizeof(stamp), callback_data.buffer_->size()));
+    return stamp;
+}
+
+bool waitForConnection(const stps::Publisher& publisher, size_t subscriber_count)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (publisher.getSubscriberCount() < subscriber_count)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // Give the handshake time to complete
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return true;
+}
+
+RunResult runPingPong(bool synchronous, size_t thread_count, const Options& options)
+{
+    RunResult result;
+    auto executor = std::make_shared<stps::Executor>(thread_count);
+
+    stps::Publisher ping_publisher(executor, "127.0.0.1", 0);
+    stps::Publisher pong_publisher(executor, "127.0.0.1", 0);
+
+    // Publisher copies cancel the shared publisher when destroyed, so the
+    // callback refers to it instead of copying it
+    stps::Subscriber ponger(executor);
+    ponger.setCallback(
+            [&pong_publisher](const stps::CallbackData& callback_data)
+            {
+                pong_publisher.send(callback_data.buffer_->data(), callback_data.buffer_->size());
+            }, synchronous);
+    ponger.addSession("127.0.0.1", ping_publisher.getPort());
+
+    std::mutex pong_mutex;
+    std::condition_variable pong_cv;
+    uint64_t last_pong_sequence_number = UINT64_MAX;
+
+    stps::Subscriber pinger(executor);
+    pinger.setCallback(
+            [&](const stps::CallbackData& callback_data)
+            {
+                const MessageStamp stamp = readStamp(callback_data);
+                {
+                    std::lock_guard<std::mutex> pong_lock(pong_mutex);
+                    last_pong_sequence_number = stamp.sequence_number;
+                }
+                pong_cv.notify_all();
+            }, synchronous);
+    pinger.addSession("127.0.0.1", pong_publisher.getPort());
+
+    if (!waitForConnection(ping_publisher, 1) || !waitForConnection(pong_publisher, 1))
+    {
+        std::cerr << "Ping-pong pairs did not connect" << std::endl;
+        return result;
+    }
+
+    std::vector<char> payload(std::max(options.message_size, sizeof(MessageStamp)));
+    const uint64_t interval_ns = (options.rate > 0 ? 1000000000ull / options.rate : 0);
+    const auto start = std::chrono::steady_clock::now();
+
+    // Sequence numbers below 1000 are used for warm up and not recorded
+    const uint64_t warmup_count = 1000;
+    for (uint64_t sequence_number = 0; sequence_number < warmup_count + options.count; ++sequence_number)
+    {
+        if (interval_ns > 0)
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(interval_ns * sequence_number));
+
+        const MessageStamp stamp{sequence_number, nowNs()};
+        std::memcpy(payload.data(), &stamp, sizeof(stamp));
+        ping_publisher.send(payload.data(), payload.size());
+
+        std::unique_lock<std::mutex> pong_lock(pong_mutex);
+        const bool received = pong_cv.wait_for(pong_lock, std::chrono::seconds(1),
+                [&]() { return last_pong_sequence_number == sequence_number; });
+        const int64_t round_trip_ns = nowNs() - stamp.send_time_ns;
+        pong_lock.unlock();
+
+        if (sequence_number < warmup_count)
+            continue;
+
+        ++result.sent;
+        if (received)
+        {
+            ++result.received;
+            result.raw.record(static_cast<uint64_t>(round_trip_ns));
+            result.corrected.recordCorrected(static_cast<uint64_t>(round_trip_ns), interval_ns);
+        }
+    }
+
+    pinger.cancel();
+    ponger.cancel();
+    ping_publisher.cancel();
+    pong_publisher.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return result;
+}
+
+RunResult runOneWay(bool synchronous, size_t thread_count, const Options& options)
+{
+    RunResult result;
+    auto executor = std::make_shared<stps::Executor>(thread_count);
+
+    stps::Publisher publisher(executor, "127.0.0.1", 0);
+
+    const uint64_t interval_ns = (options.rate > 0 ? 1000000000ull / options.rate : 0);
+    const uint64_t warmup_count = 1000;
+
+    std::mutex histogram_mutex;
+    stps::Subscriber subscriber(executor);
+    subscriber.setCallback(
+            [&](const stps::CallbackData& callback_data)
+            {
+                const int64_t receive_time_ns = nowNs();
+                const MessageStamp stamp = readStamp(callback_data);
+                if (stamp.sequence_number < warmup_count)
+                    return;
+
+                const uint64_t latency_ns = static_cast<uint64_t>(receive_time_ns - stamp.send_time_ns);
+                std::lock_guard<std::mutex> histogram_lock(histogram_mutex);
+                ++result.received;
+                result.raw.record(latency_ns);
+                result.corrected.recordCorrected(latency_ns, interval_ns);
+            }, synchronous);
+    subscriber.addSession("127.0.0.1", publisher.getPort());
+
+    if (!waitForConnection(publisher, 1))
+    {
+        std::cerr << "Subscriber did not connect" << std::endl;
+        return result;
+    }
+
+    std::vector<char> payload(std::max(options.message_size, sizeof(MessageStamp)));
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t sequence_number = 0; sequence_number < warmup_count + options.count; ++sequence_number)
+    {
+        if (interval_ns > 0)
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(interval_ns * sequence_number));
+
+        const MessageStamp stamp{sequence_number, nowNs()};
+        std::memcpy(payload.data(), &stamp, sizeof(stamp));
+        publisher.send(payload.data(), payload.size());
+    }
+    result.sent = options.count;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    subscriber.cancel();
+    publisher.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> histogram_lock(histogram_mutex);
+    return result;
+}
+
+void printSummaryHeader()
+{
+    std::cout << "test,callback,threads,rate,size,sent,received";
+    for (const char* histogram : {"raw", "corrected"})
+        for (const char* percentile : {"p50", "p90", "p99", "p99.9", "p99.99", "max"})
+            std::cout << "," << histogram << "_" << percentile << "_us";
+    std::cout << "\n";
+}
+
+void printSummary(const std::string& test, const std::string& mode, size_t thread_count,
+        const Options& options, const RunResult& result)
+{
+    std::cout << test << "," << mode << "," << thread_count << "," << options.rate << ","
+        << options.message_size << "," << result.sent << "," << result.received;
+    for (const HdrHistogram* histogram : {&result.raw, &result.corrected})
+    {
+        for (double percentile : {50.0, 90.0, 99.0, 99.9, 99.99})
+            std::cout << "," << histogram->valueAtPercentile(percentile) / 1000.0;
+        std::cout << "," << histogram->max() / 1000.0;
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    // The library logs to std::cout. Silence it unless --verbose is given.
+    std::streambuf* result_buffer = std::cout.rdbuf();
+    if (!options.verbose)
+        std::cout.rdbuf(nullptr);
+
+    bool header_printed = false;
+    for (const auto& test : options.tests)
+    {
+        for (const auto& mode : options.modes)
+        {
+            for (size_t thread_count : options.thread_counts)
+            {
+                const bool synchronous = (mode == "sync");
+                if (!options.trace_prefix.empty())
+                {
+                    stps::tracing::clear();
+                    stps::tracing::enable();
+                }
+
+                RunResult result = (test == "pingpong"
+                        ? runPingPong(synchronous, thread_count, options)
+                        : runOneWay(synchronous, thread_count, options));
+
+                std::streambuf* log_buffer = std::cout.rdbuf(result_buffer);
+                if (!header_printed)
+                {
+                    printSummaryHeader();
+                    header_printed = true;
+                }
+                printSummary(test, mode, thread_count, options, result);
+
+                if (!options.hgrm_prefix.empty())
+                {
+                    const std::string file_name = options.hgrm_prefix + "_" + test + "_" + mode
+                        + "_" + std::to_string(thread_count) + "t.hgrm";
+                    std::ofstream hgrm_file(file_name);
+                    result.corrected.outputPercentileDistribution(hgrm_file, 1000.0);
+                }
+
+                if (!options.trace_prefix.empty())
+                {
+                    stps::tracing::disable();
+                    stps::tracing::writeChromeTrace(options.trace_prefix + "_" + test + "_" + mode
+                        + "_" + std::to_string(thread_count) + "t.json");
+                }
+                std::cout.rdbuf(log_buffer);
+            }
+        }
+    }
+
+    std::cout.rdbuf(result_buffer);
+    return 0;
+}
@@ -0,0 +1,417 @@
+// Microbenchmarks for the library's internal hot paths.
+//
+// The harness follows Google Benchmark's conventions: every benchmark loops
+// over State::keepRunning(), the iteration count is scaled until a run takes
+// at least --min-time seconds, and --format=json emits Google Benchmark
+// compatible JSON so that its compare.py can diff two runs.
+//
+// Usage:
+//   stps_microbench [--filter=SUBSTRING] [--min-time=0.5] [--format=console|json]
+
+#include <stps/executor/executor.h>
+#include <stps/executor/executor_impl.h>
+#include <stps/publisher/publisher_impl.h>
+#include <stps/subscriber/subscriber_impl.h>
+#include <stps/tcp_header.h>
+
+#include <stps/boost_asio.h>
+#include <recycle/shared_pool.hpp>
+
+#include <endian.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+template <class T>
+inline void doNotOptimize(T const& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class State
+{
+    public:
+        State(uint64_t iterations, int64_t argument, int thread_index)
+            : remaining_(iterations)
+            , argument_(argument)
+            , thread_index_(thread_index)
+        {}
+
+        bool keepRunning()
+        {
+            if (remaining_ == 0)
+                return false;
+            --remaining_;
+            return true;
+        }
+
+        int64_t argument() const { return argument_; }
+        int threadIndex() const { return thread_index_; }
+
+    private:
+        uint64_t remaining_;
+        const int64_t argument_;
+        const int thread_index_;
+};
+
+struct Benchmark
+{
+    std::string name;
+    std::function<void(State&)> function;
+    std::vector<int64_t> arguments{0};
+    std::vector<int> thread_counts{1};
+};
+
+struct Result
+{
+    std::string name;
+    uint64_t iterations;
+    int threads;
+    double real_time_ns;
+    double cpu_time_ns;
+    double items_per_second;
+};
+
+double threadCpuSeconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+// Runs the benchmark function on thread_count threads that start together.
+// Returns the wall time and the summed CPU time of all threads.
+std::pair<double, double> runOnce(const Benchmark& benchmark, int64_t argument,
+        int thread_count, uint64_t iterations)
+{
+    std::mutex start_mutex;
+    std::condition_variable start_cv;
+    int ready_threads = 0;
+    bool go = false;
+    std::atomic<double> cpu_seconds{0.0};
+
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < thread_count; ++thread_index)
+    {
+        threads.emplace_back([&, thread_index]()
+                {
+                    State state(iterations, argument, thread_index);
+                    {
+                        std::unique_lock<std::mutex> start_lock(start_mutex);
+                        ++ready_threads;
+                        start_cv.notify_all();
+                        start_cv.wait(start_lock, [&]() { return go; });
+                    }
+                    const double cpu_start = threadCpuSeconds();
+                    benchmark.function(state);
+                    const double cpu_used = threadCpuSeconds() - cpu_start;
+                    double expected = cpu_seconds.load();
+                    while (!cpu_seconds.compare_exchange_weak(expected, expected + cpu_used)) {}
+                });
+    }
+
+    std::chrono::steady_clock::time_point start;
+    {
+        std::unique_lock<std::mutex> start_lock(start_mutex);
+        start_cv.wait(start_lock, [&]() { return ready_threads == thread_count; });
+        start = std::chrono::steady_clock::now();
+        go = true;
+    }
+    start_cv.notify_all();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {wall_seconds, cpu_seconds.load()};
+}
+
+Result runBenchmark(const Benchmark& benchmark, int64_t argument, int thread_count, double min_time)
+{
+    uint64_t iterations = 1;
+    for (;;)
+    {
+        const auto times = runOnce(benchmark, argument, thread_count, iterations);
+        const double wall_seconds = times.first;
+
+        if ((wall_seconds >= min_time) || (iterations >= 1000000000ull))
+        {
+            Result result;
+            result.name = benchmark.name;
+            // Appended piece by piece, "/" + std::to_string() inserts in
+            // front of the temporary, which GCC 12 flags with -Wrestrict
+            if (benchmark.arguments.size() > 1 || argument != 0)
+                result.name.append("/").append(std::to_string(argument));
+            if (benchmark.thread_counts.size() > 1)
+                result.name.append("/threads:").append(std::to_string(thread_count));
+            result.iterations = iterations;
+            result.threads = thread_count;
+            result.real_time_ns = wall_seconds * 1e9 / iterations;
+            result.cpu_time_ns = times.second * 1e9 / (static_cast<double>(iterations) * thread_count);
+            result.items_per_second = static_cast<double>(iterations) * thread_count / wall_seconds;
+            return result;
+        }
+
+        // Same scaling rule as Google Benchmark: aim 40% above the minimum
+        // time, but grow by at most 10x per step
+        const double multiplier = (wall_seconds > 0.0 ? min_time * 1.4 / wall_seconds : 10.0);
+        iterations = static_cast<uint64_t>(static_cast<double>(iterations) * std::min(std::max(multiplier, 1.0), 10.0)) + 1;
+    }
+}
+
+using Payloads = std::vector<std::pair<const char* const, const size_t>>;
+
+// PublisherImpl::send framing: header plus 1..N fragments that add up to 4 KiB
+void BM_PublisherCreateFrame(State& state)
+{
+    auto executor = std::make_shared<stps::Executor>(1);
+    auto publisher_impl = std::make_shared<stps::PublisherImpl>(executor);
+
+    const size_t fragment_count = static_cast<size_t>(state.argument());
+    const size_t fragment_size = 4096 / fragment_count;
+    std::vector<char> data(4096, 'x');
+
+    Payloads payloads;
+    for (size_t i = 0; i < fragment_count; ++i)
+        payloads.emplace_back(data.data() + i * fragment_size, fragment_size);
+
+    while (state.keepRunning())
+    {
+        auto buffer = publisher_impl->createFrame(payloads.data(), payloads.size());
+        doNotOptimize(buffer->data());
+    }
+}
+
+// Buffer pool allocate/release with the lock policy used by PublisherImpl and
+// SubscriberImpl, shared by all benchmark threads
+struct BufferPoolLockPolicy
+{
+    using mutex_type = std::mutex;
+    using lock_type = std::lock_guard<mutex_type>;
+};
+
+recycle::shared_pool<stps::Buffer, BufferPoolLockPolicy> shared_buffer_pool;
+
+void BM_BufferPoolAllocateRelease(State& state)
+{
+    while (state.keepRunning())
+    {
+        auto buffer = shared_buffer_pool.allocate();
+        doNotOptimize(buffer.get());
+    }
+}
+
+void BM_TCPHeaderEncode(State& state)
+{
+    alignas(8) char frame[sizeof(stps::TCPHeader)];
+    uint64_t data_size = 0;
+    while (state.keepRunning())
+    {
+        auto header = reinterpret_cast<stps::TCPHeader*>(frame);
+        header->header_size = htole16(sizeof(stps::TCPHeader));
+        header->type = stps::MessageContentType::RegularPayload;
+        header->reserved = 0;
+        header->data_size = htole64(++data_size);
+        header->sequence_number = htole64(data_size);
+        doNotOptimize(frame);
+    }
+}
+
+void BM_TCPHeaderDecode(State& state)
+{
+    alignas(8) char frame[sizeof(stps::TCPHeader)];
+    auto encoded = reinterpret_cast<stps::TCPHeader*>(frame);
+    encoded->header_size = htole16(sizeof(stps::TCPHeader));
+    encoded->type = stps::MessageContentType::RegularPayload;
+    encoded->reserved = 0;
+    encoded->data_size = htole64(4096);
+    encoded->sequence_number = htole64(1);
+
+    while (state.keepRunning())
+    {
+        doNotOptimize(frame);
+        stps::TCPHeader header;
+        std::memcpy(&header, frame, sizeof(header));
+        const uint16_t header_size = le16toh(header.header_size);
+        const uint64_t data_size = le64toh(header.data_size);
+        const uint64_t sequence_number = le64toh(header.sequence_number);
+        doNotOptimize(header_size);
+        doNotOptimize(data_size);
+        doNotOptimize(sequence_number);
+    }
+}
+
+// Post + execution of one handler through a strand. The io_service is drained
+// every 1024 posts.
+void BM_StrandPost(State& state)
+{
+    asio::io_service io_service;
+    asio::io_service::strand strand(io_service);
+    uint64_t executed = 0;
+    uint64_t posted = 0;
+
+    while (state.keepRunning())
+    {
+        strand.post([&executed]() { ++executed; });
+        if ((++posted % 1024) == 0)
+        {
+            io_service.poll();
+            io_service.restart();
+        }
+    }
+    io_service.poll();
+    doNotOptimize(executed);
+}
+
+// Dispatch from within the strand, which runs the handler inline
+void BM_StrandDispatch(State& state)
+{
+    asio::io_service io_service;
+    asio::io_service::strand strand(io_service);
+    uint64_t executed = 0;
+
+    strand.post([&]()
+            {
+                while (state.keepRunning())
+                {
+                    strand.dispatch([&executed]() { ++executed; });
+                }
+            });
+    io_service.run();
+    doNotOptimize(executed);
+}
+
+// SubscriberImpl handoff of a received buffer to the user callback.
+// Argument 1: synchronous callback, 0: asynchronous callback thread.
+void BM_SubscriberHandoff(State& state)
+{
+    auto executor = std::make_shared<stps::Executor>(1);
+    auto subscriber_impl = std::make_shared<stps::SubscriberImpl>(executor);
+
+    std::atomic<uint64_t> delivered{0};
+    subscriber_impl->setCallback([&delivered](const stps::CallbackData&) { ++delivered; },
+            state.argument() != 0);
+
+    auto buffer = std::make_shared<stps::Buffer>(64);
+    auto header = std::make_shared<stps::TCPHeader>();
+    while (state.keepRunning())
+    {
+        subscriber_impl->handleReceivedBuffer(buffer, header, 0, nullptr);
+    }
+
+    subscriber_impl->cancel();
+    doNotOptimize(delivered.load());
+}
+
+std::vector<Benchmark> registerBenchmarks()
+{
+    return {
+        {"BM_PublisherCreateFrame", BM_PublisherCreateFrame, {1, 4, 16, 64}, {1}},
+        {"BM_BufferPoolAllocateRelease", BM_BufferPoolAllocateRelease, {0}, {1, 2, 4, 8}},
+        {"BM_TCPHeaderEncode", BM_TCPHeaderEncode, {0}, {1}},
+        {"BM_TCPHeaderDecode", BM_TCPHeaderDecode, {0}, {1}},
+        {"BM_StrandPost", BM_StrandPost, {0}, {1}},
+        {"BM_StrandDispatch", BM_StrandDispatch, {0}, {1}},
+        {"BM_SubscriberHandoff", BM_SubscriberHandoff, {0, 1}, {1}},
+    };
+}
+
+void printConsole(const std::vector<Result>& results)
+{
+    std::cout << std::left << std::setw(48) << "Benchmark" << std::right
+        << std::setw(14) << "Time" << std::setw(14) << "CPU"
+        << std::setw(14) << "Iterations" << std::setw(16) << "items/s" << "\n"
+        << std::string(106, '-') << "\n";
+    for (const auto& result : results)
+    {
+        std::cout << std::left << std::setw(48) << result.name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(11) << result.real_time_ns << " ns"
+            << std::setw(11) << result.cpu_time_ns << " ns"
+            << std::setw(14) << result.iterations
+            << std::setprecision(0) << std::setw(16) << result.items_per_second << "\n";
+    }
+}
+
+void printJson(const std::vector<Result>& results)
+{
+    std::cout << "{\n  \"context\": {\n    \"executable\": \"stps_microbench\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << "\n  },\n"
+        << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& result = results[i];
+        std::cout << (i == 0 ? "\n" : ",\n")
+            << "    {\"name\": \"" << result.name << "\", \"run_name\": \"" << result.name
+            << "\", \"run_type\": \"iteration\", \"iterations\": " << result.iterations
+            << ", \"threads\": " << result.threads
+            << ", \"real_time\": " << result.real_time_ns
+            << ", \"cpu_time\": " << result.cpu_time_ns
+            << ", \"time_unit\": \"ns\", \"items_per_second\": " << result.items_per_second << "}";
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    double min_time = 0.5;
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const size_t equal_pos = arg.find('=');
+        const std::string key = arg.substr(0, equal_pos);
+        const std::string value = (equal_pos == std::string::npos ? "" : arg.substr(equal_pos + 1));
+
+        if (key == "--filter")
+            filter = value;
+        else if (key == "--min-time")
+            min_time = std::stod(value);
+        else if (key == "--format")
+            json = (value == "json");
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // The library logs to std::cout
+    std::streambuf* result_buffer = std::cout.rdbuf(nullptr);
+
+    std::vector<Result> results;
+    for (const auto& benchmark : registerBenchmarks())
+    {
+        if (!filter.empty() && (benchmark.name.find(filter) == std::string::npos))
+            continue;
+
+        for (int64_t argument : benchmark.arguments)
+            for (int thread_count : benchmark.thread_counts)
+                results.push_back(runBenchmark(benchmark, argument, thread_count, min_time));
+    }
+
+    std::cout.rdbuf(result_buffer);
+    if (json)
+        printJson(results);
+    else
+        printConsole(results);
+
+    return 0;
+}
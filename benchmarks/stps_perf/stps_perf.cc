@@ -0,0 +1,371 @@
+// Throughput and fan-out benchmark.
+//
+// Runs one publisher and N subscribers over loopback for every combination of
+// message size, publish rate, subscriber count and executor thread count and
+// prints one result row per combination as CSV or JSON.
+//
+// Usage:
+//   stps_perf [--sizes=64,1024,65536] [--rates=0] [--subscribers=1,10]
+//             [--threads=1,4] [--duration=2] [--queue-size=1] [--batch=1]
+//             [--format=csv|json] [--executor-stats] [--verbose]
+//
+// A rate of 0 publishes as fast as possible. With --batch=N > 1 messages are
+// published N at a time with Publisher::sendBatch(); the rate stays in
+// messages per second.
+//
+// --executor-stats enables the executor statistics during the measurement and
+// fills the queue delay and thread utilization columns (0 otherwise).
+
+#include <stps/executor/executor.h>
+#include <stps/publisher/publisher.h>
+#include <stps/subscriber/subscriber.h>
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct Options
+{
+    std::vector<size_t> message_sizes{64, 1024, 65536};
+    std::vector<size_t> publish_rates{0};
+    std::vector<size_t> subscriber_counts{1, 10};
+    std::vector<size_t> thread_counts{1, 4};
+    std::chrono::milliseconds duration{2000};
+    size_t queue_size = 1;
+    size_t batch_size = 1;
+    bool json = false;
+    bool executor_stats = false;
+    bool verbose = false;
+};
+
+struct Result
+{
+    size_t message_size = 0;
+    size_t publish_rate = 0;
+    size_t subscriber_count = 0;
+    size_t thread_count = 0;
+    uint64_t sent_messages = 0;
+    uint64_t delivered_messages = 0;
+    double elapsed_s = 0.0;
+    double cpu_s = 0.0;
+    double queue_delay_mean_us = 0.0;
+    double queue_delay_max_us = 0.0;
+    double thread_busy_ratio = 0.0;
+};
+
+// Every subscriber gets its own counters on a separate cache line
+struct alignas(64) SubscriberCounters
+{
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+std::vector<size_t> parseList(const std::string& value)
+{
+    std::vector<size_t> list;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+            list.push_back(std::stoull(item));
+    }
+    return list;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const size_t equal_pos = arg.find('=');
+        const std::string key = arg.substr(0, equal_pos);
+        const std::string value = (equal_pos == std::string::npos ? "" : arg.substr(equal_pos + 1));
+
+        if (key == "--sizes")
+            options.message_sizes = parseList(value);
+        else if (key == "--rates")
+            options.publish_rates = parseList(value);
+        else if (key == "--subscribers")
+            options.subscriber_counts = parseList(value);
+        else if (key == "--threads")
+            options.thread_counts = parseList(value);
+        else if (key == "--duration")
+            options.duration = std::chrono::milliseconds(static_cast<int64_t>(std::stod(value) * 1000));
+        else if (key == "--queue-size")
+            options.queue_size = std::stoull(value);
+        else if (key == "--batch")
+            options.batch_size = std::max<size_t>(std::stoull(value), 1);
+        else if (key == "--format")
+            options.json = (value == "json");
+        else if (key == "--executor-stats")
+            options.executor_stats = true;
+        else if (key == "--verbose")
+            options.verbose = true;
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+double processCpuSeconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+void raiseFileDescriptorLimit()
+{
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+uint64_t deliveredMessages(const std::vector<SubscriberCounters>& counters)
+{
+    uint64_t sum = 0;
+    for (const auto& counter : counters)
+        sum += counter.messages;
+    return sum;
+}
+
+Result runBenchmark(size_t message_size, size_t publish_rate, size_t subscriber_count,
+        size_t thread_count, const Options& options)
+{
+    Result result;
+    result.message_size = message_size;
+    result.publish_rate = publish_rate;
+    result.subscriber_count = subscriber_count;
+    result.thread_count = thread_count;
+
+    auto executor = std::make_shared<stps::Executor>(thread_count);
+    stps::Publisher publisher(executor, "127.0.0.1", 0);
+    publisher.setSendQueueSize(options.queue_size);
+
+    std::vector<SubscriberCounters> counters(subscriber_count);
+    std::vector<std::unique_ptr<stps::Subscriber>> subscribers;
+    for (size_t i = 0; i < subscriber_count; ++i)
+    {
+        subscribers.push_back(std::make_unique<stps::Subscriber>(executor));
+        SubscriberCounters* counter = &counters[i];
+        subscribers.back()->setCallback(
+                [counter](const stps::CallbackData& callback_data)
+                {
+                    counter->messages.fetch_add(1, std::memory_order_relaxed);
+                    counter->bytes.fetch_add(callback_data.buffer_->size(), std::memory_order_relaxed);
+                }, true);
+        subscribers.back()->addSession("127.0.0.1", publisher.getPort());
+    }
+
+    std::vector<char> payload(std::max(message_size, sizeof(uint64_t)));
+
+    // One payload per message of a batch
+    const size_t payload_size = payload.size();
+    std::vector<char> batch_payloads(payload_size * options.batch_size);
+    std::vector<std::pair<const char* const, const size_t>> batch;
+    for (size_t i = 0; i < options.batch_size; ++i)
+        batch.emplace_back(batch_payloads.data() + i * payload_size, payload_size);
+
+    // Warm up until every subscriber has completed its handshake and received data
+    const auto warmup_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    for (;;)
+    {
+        publisher.send(payload.data(), payload.size());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        bool all_received = true;
+        for (const auto& counter : counters)
+            all_received = all_received && (counter.messages > 0);
+        if (all_received)
+            break;
+        if (std::chrono::steady_clock::now() > warmup_deadline)
+        {
+            std::cerr << "Not all subscribers connected within 30 s" << std::endl;
+            break;
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (auto& counter : counters)
+    {
+        counter.messages = 0;
+        counter.bytes = 0;
+    }
+
+    if (options.executor_stats)
+        executor->enableStatistics();
+
+    const double cpu_start = processCpuSeconds();
+    const auto start = std::chrono::steady_clock::now();
+    const auto send_end = start + options.duration;
+    const auto send_interval = (publish_rate > 0
+            ? std::chrono::nanoseconds(1000000000ull * options.batch_size / publish_rate)
+            : std::chrono::nanoseconds(0));
+    auto next_send = start;
+
+    uint64_t sequence_number = 0;
+    for (auto now = start; now < send_end; now = std::chrono::steady_clock::now())
+    {
+        if (publish_rate > 0)
+        {
+            if (now < next_send)
+            {
+                std::this_thread::sleep_until(next_send);
+                continue;
+            }
+            next_send += send_interval;
+        }
+
+        if (options.batch_size > 1)
+        {
+            for (size_t i = 0; i < options.batch_size; ++i, ++sequence_number)
+                std::memcpy(batch_payloads.data() + i * payload_size, &sequence_number, sizeof(sequence_number));
+            publisher.sendBatch(batch);
+        }
+        else
+        {
+            std::memcpy(payload.data(), &sequence_number, sizeof(sequence_number));
+            publisher.send(payload.data(), payload.size());
+            ++sequence_number;
+        }
+    }
+
+    // Drain: wait until the delivered count stops changing
+    uint64_t last_delivered = deliveredMessages(counters);
+    for (;;)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        const uint64_t delivered = deliveredMessages(counters);
+        if (delivered == last_delivered)
+            break;
+        last_delivered = delivered;
+    }
+
+    result.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.cpu_s = processCpuSeconds() - cpu_start;
+    result.sent_messages = sequence_number;
+    result.delivered_messages = last_delivered;
+
+    if (options.executor_stats)
+    {
+        const stps::ExecutorStatistics statistics = executor->getStatistics();
+        result.queue_delay_mean_us = statistics.queue_delay_mean.count() / 1000.0;
+        result.queue_delay_max_us = statistics.queue_delay_max.count() / 1000.0;
+
+        double busy_s = 0.0;
+        double total_s = 0.0;
+        for (const auto& thread : statistics.threads)
+        {
+            busy_s += std::chrono::duration<double>(thread.busy_time).count();
+            total_s += std::chrono::duration<double>(thread.busy_time + thread.idle_time).count();
+        }
+        result.thread_busy_ratio = (total_s > 0.0 ? busy_s / total_s : 0.0);
+    }
+
+    for (auto& subscriber : subscribers)
+        subscriber->cancel();
+    publisher.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    return result;
+}
+
+void printResult(const Result& result, bool json, bool first)
+{
+    const double expected = static_cast<double>(result.sent_messages) * result.subscriber_count;
+    const double drop_rate = (expected > 0 ? 1.0 - result.delivered_messages / expected : 0.0);
+    const double msgs_per_s = result.delivered_messages / result.elapsed_s;
+    const double mb_per_s = msgs_per_s * result.message_size / (1024.0 * 1024.0);
+    const double cpu_us_per_message = (result.delivered_messages > 0
+            ? result.cpu_s * 1e6 / result.delivered_messages : 0.0);
+
+    if (json)
+    {
+        std::cout << (first ? "[\n" : ",\n")
+            << "  {\"message_size\": " << result.message_size
+            << ", \"publish_rate\": " << result.publish_rate
+            << ", \"subscribers\": " << result.subscriber_count
+            << ", \"threads\": " << result.thread_count
+            << ", \"sent\": " << result.sent_messages
+            << ", \"delivered\": " << result.delivered_messages
+            << ", \"msgs_per_s\": " << msgs_per_s
+            << ", \"mb_per_s\": " << mb_per_s
+            << ", \"drop_rate\": " << drop_rate
+            << ", \"cpu_us_per_msg\": " << cpu_us_per_message
+            << ", \"queue_delay_mean_us\": " << result.queue_delay_mean_us
+            << ", \"queue_delay_max_us\": " << result.queue_delay_max_us
+            << ", \"thread_busy_ratio\": " << result.thread_busy_ratio << "}";
+    }
+    else
+    {
+        if (first)
+            std::cout << "message_size,publish_rate,subscribers,threads,sent,delivered,"
+                "msgs_per_s,mb_per_s,drop_rate,cpu_us_per_msg,"
+                "queue_delay_mean_us,queue_delay_max_us,thread_busy_ratio\n";
+        std::cout << result.message_size << "," << result.publish_rate << ","
+            << result.subscriber_count << "," << result.thread_count << ","
+            << result.sent_messages << "," << result.delivered_messages << ","
+            << msgs_per_s << "," << mb_per_s << "," << drop_rate << ","
+            << cpu_us_per_message << "," << result.queue_delay_mean_us << ","
+            << result.queue_delay_max_us << "," << result.thread_busy_ratio << "\n";
+    }
+    std::cout.flush();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    raiseFileDescriptorLimit();
+
+    // The library logs to std::cout. Results go to the original stream buffer,
+    // everything else is silenced unless --verbose is given.
+    std::streambuf* result_buffer = std::cout.rdbuf();
+    if (!options.verbose)
+        std::cout.rdbuf(nullptr);
+
+    bool first = true;
+    for (size_t thread_count : options.thread_counts)
+        for (size_t subscriber_count : options.subscriber_counts)
+            for (size_t message_size : options.message_sizes)
+                for (size_t publish_rate : options.publish_rates)
+                {
+                    const Result result = runBenchmark(message_size, publish_rate,
+                            subscriber_count, thread_count, options);
+
+                    std::streambuf* log_buffer = std::cout.rdbuf(result_buffer);
+                    std::cout.clear();
+                    printResult(result, options.json, first);
+                    std::cout.rdbuf(log_buffer);
+                    first = false;
+                }
+
+    std::cout.rdbuf(result_buffer);
+    std::cout.clear();
+    if (options.json && !first)
+        std::cout << "\n]" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Include Boost.Asio through this header. With STPS_ENABLE_COROUTINES the
+// awaitable.hpp of older Boost versions is pulled in and uses std::exchange
+// without including <utility>.
+#include <utility>
+#include <boost/asio.hpp>
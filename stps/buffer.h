@@ -0,0 +1,12 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+
+namespace stps
+{
+// A frame or message buffer. Its memory comes from the memory resource of
+// the buffer pool that created it (see BufferArena), so it is returned there
+// even if the buffer outlives the pool.
+using Buffer = std::pmr::vector<char>;
+} // namespace stps
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stps/buffer.h>
+
 #include <vector>
 #include <chrono>
 #include <memory>
@@ -9,6 +11,23 @@ namespace stps
 {
 struct CallbackData
 {
-    std::shared_ptr<std::vector<char>> buffer_;
+    std::shared_ptr<Buffer> buffer_;
+
+    // Assigned by the publisher, 0 if the publisher does not send sequence
+    // numbers (protocol version 0)
+    uint64_t sequence_number_ = 0;
+
+    // Messages of the same session that did not reach this callback since the
+    // previous one: skipped sequence numbers, i.e. messages the publisher
+    // dropped or conflated for this subscriber. With priorities or keyed
+    // conflation frames may arrive out of order; a gap is reported once the
+    // session's missed messages (see SubscriberSessionStatistics) grow. A
+    // frame filling it later cannot take the report back, so the sum may
+    // exceed the session's count ...
+    uint64_t missed_messages_ = 0;
+
+    // ... and received messages that were replaced by a newer one before the
+    // asynchronous callback could run
+    uint64_t dropped_callbacks_ = 0;
 };
 } // namespace stps
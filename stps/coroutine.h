@@ -0,0 +1,27 @@
+#pragma once
+
+// C++20 coroutine API: Subscriber::receive(), Publisher::sendAsync() and
+// Executor::getAsioExecutor(). Compiled in by the CMake option
+// STPS_ENABLE_COROUTINES, which builds the library and its users with C++20.
+// The library and all of its users must agree on the option.
+//
+// Example:
+//   boost::asio::co_spawn(executor->getAsioExecutor(),
+//           [&]() -> boost::asio::awaitable<void>
+//           {
+//               for (;;)
+//               {
+//                   stps::CallbackData message = co_await subscriber.receive();
+//                   co_await publisher.sendAsync(message.buffer_->data(), message.buffer_->size());
+//               }
+//           }, boost::asio::detached);
+
+#ifdef STPS_ENABLE_COROUTINES
+#include <utility> // std::exchange, not included by awaitable.hpp of older Boost versions
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#if !defined(BOOST_ASIO_HAS_CO_AWAIT)
+#error "STPS_ENABLE_COROUTINES requires a compiler with C++20 coroutine support"
+#endif
+#define STPS_HAS_COROUTINES 1
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+#include <stddef.h>
+
+namespace stps
+{
+	// Every evaluation_interval the mean handler queue delay (see
+	// ExecutorStatistics) of that interval is compared to the thresholds. Above
+	// scale_up_queue_delay one thread is added, below scale_down_queue_delay one
+	// thread is removed, always staying within [min_threads, max_threads].
+	struct AutoScalingPolicy
+	{
+		size_t min_threads = 1;
+		size_t max_threads = 8;
+		std::chrono::microseconds scale_up_queue_delay{1000};
+		std::chrono::microseconds scale_down_queue_delay{100};
+		std::chrono::milliseconds evaluation_interval{1000};
+		std::chrono::milliseconds probe_interval{10};
+	};
+} // namespace stps
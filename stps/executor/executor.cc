@@ -13,4 +13,62 @@ Executor::~Executor()
 {
 	executor_impl_->stop();
 }
+
+void Executor::enableStatistics(std::chrono::milliseconds probe_interval)
+{
+	executor_impl_->enableStatistics(probe_interval);
+}
+
+void Executor::disableStatistics()
+{
+	executor_impl_->disableStatistics();
+}
+
+ExecutorStatistics Executor::getStatistics() const
+{
+	return executor_impl_->getStatistics();
+}
+
+void Executor::setThreadCount(size_t thread_count)
+{
+	executor_impl_->setThreadCount(thread_count);
+}
+
+size_t Executor::getThreadCount() const
+{
+	return executor_impl_->getThreadCount();
+}
+
+void Executor::enableAutoScaling(const AutoScalingPolicy& policy)
+{
+	executor_impl_->enableAutoScaling(policy);
+}
+
+void Executor::disableAutoScaling()
+{
+	executor_impl_->disableAutoScaling();
+}
+
+void Executor::enableBufferMemory(const BufferMemoryPolicy& policy,
+		const std::shared_ptr<std::pmr::memory_resource>& upstream_resource)
+{
+	executor_impl_->enableBufferMemory(policy, upstream_resource);
+}
+
+void Executor::disableBufferMemory()
+{
+	executor_impl_->disableBufferMemory();
+}
+
+BufferMemoryStatistics Executor::getBufferMemoryStatistics() const
+{
+	return executor_impl_->getBufferMemoryStatistics();
+}
+
+#ifdef STPS_HAS_COROUTINES
+boost::asio::io_context::executor_type Executor::getAsioExecutor() const
+{
+	return executor_impl_->ioService()->get_executor();
+}
+#endif
 } // namespace stps
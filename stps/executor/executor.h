@@ -1,12 +1,21 @@
 #pragma once
 
+#include <stps/executor/auto_scaling_policy.h>
+#include <stps/executor/executor_statistics.h>
+#include <stps/coroutine.h>
+#include <stps/memory/buffer_memory_policy.h>
+#include <stps/memory/buffer_memory_statistics.h>
+
+#include <chrono>
 #include <string>
 #include <memory>
+#include <memory_resource>
 
 #include <stdint.h>
 
 namespace stps
 {
+	class EgressLimiter;
 	class ExecutorImpl;
 	class PublisherImpl;
 	class SubscriberImpl;
@@ -26,7 +35,48 @@ namespace stps
 
 			Executor(Executor&&) = default;
 
+			// Starts (or restarts) collecting statistics. The handler queue delay
+			// is sampled every probe_interval.
+			void enableStatistics(std::chrono::milliseconds probe_interval = std::chrono::milliseconds(10));
+
+			void disableStatistics();
+
+			ExecutorStatistics getStatistics() const;
+
+			// Adds or removes threads. Removed threads finish the handler they are
+			// running first. Called from outside the executor this blocks until
+			// they have exited.
+			void setThreadCount(size_t thread_count);
+
+			size_t getThreadCount() const;
+
+			// Adjusts the thread count to the measured handler queue delay until
+			// disabled. setThreadCount() may still be used meanwhile.
+			void enableAutoScaling(const AutoScalingPolicy& policy = AutoScalingPolicy());
+
+			void disableAutoScaling();
+
+			// Publishers and subscribers created afterwards take their buffers
+			// from memory shared by the whole executor instead of keeping idle
+			// buffers in pools of their own. The upstream resource supplies the
+			// memory, e.g. a BufferArena; nullptr uses the heap. Enabling it
+			// again starts new shared memory for the ones created afterwards.
+			void enableBufferMemory(const BufferMemoryPolicy& policy = BufferMemoryPolicy(),
+					const std::shared_ptr<std::pmr::memory_resource>& upstream_resource = nullptr);
+
+			// Publishers and subscribers created afterwards use their own pools
+			void disableBufferMemory();
+
+			// Of the shared memory enabled last
+			BufferMemoryStatistics getBufferMemoryStatistics() const;
+
+#ifdef STPS_HAS_COROUTINES
+			// For co_spawn()ing coroutines on the library's threads
+			boost::asio::io_context::executor_type getAsioExecutor() const;
+#endif
+
 		private:
+			friend ::stps::EgressLimiter;
 			friend ::stps::PublisherImpl;
 			friend ::stps::SubscriberImpl;
 			std::shared_ptr<ExecutorImpl> executor_impl_;
@@ -1,11 +1,29 @@
 #include <stps/executor/executor_impl.h>
 #include <iostream>
+#include <algorithm>
+
+#include <pthread.h>
 
 namespace stps
 {
 	ExecutorImpl::ExecutorImpl()
         : io_service_(std::make_shared<asio::io_service>())
         , dummy_work_(std::make_shared<asio::io_service::work>(*io_service_))
+        , thread_count_(0)
+        , pending_exit_tokens_(0)
+        , stopped_(false)
+        , handler_statistics_(std::make_shared<HandlerStatistics>())
+        , statistics_enabled_(false)
+        , statistics_generation_(0)
+        , probe_interval_(10)
+        , probe_timer_(*io_service_)
+        , queue_delay_samples_(0)
+        , queue_delay_sum_(0)
+        , queue_delay_last_(0)
+        , queue_delay_max_(0)
+        , auto_scaling_enabled_(false)
+        , auto_scaling_window_samples_(0)
+        , auto_scaling_window_delay_sum_(0)
     {
 
 	}
@@ -16,9 +34,21 @@ namespace stps
 		ss << std::this_thread::get_id();
 		std::string thread_id = ss.str();
 		std::cout << "Executor: Deleting from thread " << thread_id << std::endl;
-		for (std::thread& thread : thread_pool_)
+
+		dummy_work_.reset();
+		io_service_->stop();
+
+		// Every thread keeps the executor alive until it has left
+		// io_service::run(), so joining does not wait for handlers. The last
+		// one to leave may be the thread destroying the executor.
+		for (const auto& pool_thread : thread_pool_)
 		{
-			thread.detach();
+			if (!pool_thread->thread.joinable())
+				continue;
+			if (pool_thread->thread.get_id() == std::this_thread::get_id())
+				pool_thread->thread.detach();
+			else
+				pool_thread->thread.join();
 		}
 
 		thread_pool_.clear();
@@ -26,28 +56,412 @@ namespace stps
 
 	void ExecutorImpl::start(size_t thread_count)
 	{
-		for (size_t i = 0; i < thread_count; ++i)
+		setThreadCount(thread_count);
+	}
+
+	namespace
+	{
+		// Thrown by a handler to make the thread running it leave io_service::run()
+		struct ExitToken {};
+
+		std::chrono::nanoseconds cpuTime(clockid_t cpu_clock)
 		{
-			thread_pool_.emplace_back(
-					[me = shared_from_this()]()
+			timespec ts{};
+			clock_gettime(cpu_clock, &ts);
+			return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+		}
+	}
+
+	void ExecutorImpl::setThreadCount(size_t thread_count)
+	{
+		std::unique_lock<std::mutex> thread_pool_lock(thread_pool_mutex_);
+		if (stopped_) return;
+
+		while (thread_count_ < thread_count)
+		{
+			auto pool_thread = std::make_shared<PoolThread>();
+			pool_thread->thread = std::thread(
+					[me = shared_from_this(), pool_thread]()
 					{
 						std::stringstream ss;
 						ss << std::this_thread::get_id();
 						std::string thread_id = ss.str();
 						std::cout << "Executor: IoService::Run() in thread " + thread_id << std::endl;
-						me->io_service_->run();
+						me->runThread(pool_thread);
 					});
+			thread_pool_.push_back(pool_thread);
+			thread_count_++;
 		}
+
+		while (thread_count_ > thread_count)
+		{
+			// Whichever thread runs the token exits
+			io_service_->post([]() { throw ExitToken(); });
+			thread_count_--;
+			pending_exit_tokens_++;
+		}
+
+		if (!isPoolThread())
+		{
+			thread_exited_cv_.wait(thread_pool_lock, 
+					[this]() { return (pending_exit_tokens_ == 0) || stopped_; });
+		}
+
+		joinFinishedThreads(thread_pool_lock);
+	}
+
+	size_t ExecutorImpl::getThreadCount() const
+	{
+		std::lock_guard<std::mutex> thread_pool_lock(thread_pool_mutex_);
+		return thread_count_;
+	}
+
+	void ExecutorImpl::joinFinishedThreads(std::unique_lock<std::mutex>& thread_pool_lock)
+	{
+		std::vector<std::shared_ptr<PoolThread>> finished_threads;
+		for (auto it = thread_pool_.begin(); it != thread_pool_.end();)
+		{
+			if ((*it)->finished)
+			{
+				finished_threads.push_back(*it);
+				it = thread_pool_.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		thread_pool_lock.unlock();
+		for (const auto& pool_thread : finished_threads)
+		{
+			if (pool_thread->thread.get_id() == std::this_thread::get_id())
+				pool_thread->thread.detach();
+			else
+				pool_thread->thread.join();
+		}
+		thread_pool_lock.lock();
+	}
+
+	bool ExecutorImpl::isPoolThread() const
+	{
+		// Called with thread_pool_mutex_ held
+		for (const auto& pool_thread : thread_pool_)
+		{
+			if (pool_thread->thread.get_id() == std::this_thread::get_id())
+				return true;
+		}
+		return false;
+	}
+
+	void ExecutorImpl::runThread(const std::shared_ptr<PoolThread>& pool_thread)
+	{
+		auto thread_record = std::make_shared<ThreadRecord>();
+		if (pthread_getcpuclockid(pthread_self(), &thread_record->cpu_clock) != 0)
+			thread_record->cpu_clock = CLOCK_THREAD_CPUTIME_ID;
+		thread_record->start_time = std::chrono::steady_clock::now();
+		thread_record->start_cpu_time = cpuTime(thread_record->cpu_clock);
+
+		{
+			std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+			thread_records_.push_back(thread_record);
+		}
+
+		bool exit_token_received = false;
+		try
+		{
+			io_service_->run();
+		}
+		catch (const ExitToken&)
+		{
+			exit_token_received = true;
+		}
+
+		{
+			// The clock of a thread becomes invalid when it exits
+			std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+			thread_record->end_time = std::chrono::steady_clock::now();
+			thread_record->end_cpu_time = cpuTime(CLOCK_THREAD_CPUTIME_ID);
+			thread_record->running = false;
+
+			if (!statistics_enabled_)
+			{
+				thread_records_.erase(std::remove(thread_records_.begin(), thread_records_.end(), thread_record),
+						thread_records_.end());
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> thread_pool_lock(thread_pool_mutex_);
+			pool_thread->finished = true;
+			if (exit_token_received)
+				pending_exit_tokens_--;
+		}
+		thread_exited_cv_.notify_all();
 	}
 
 	void ExecutorImpl::stop()
 	{
+		std::vector<std::shared_ptr<PoolThread>> pool_threads;
+		{
+			std::lock_guard<std::mutex> thread_pool_lock(thread_pool_mutex_);
+			stopped_ = true;
+
+			// A pool thread cannot join itself, the destructor joins the
+			// threads then
+			if (!isPoolThread())
+				pool_threads.swap(thread_pool_);
+		}
+		thread_exited_cv_.notify_all();
+
+		disableAutoScaling();
+
 		dummy_work_.reset();
 		io_service_->stop();
+
+		for (const auto& pool_thread : pool_threads)
+		{
+			if (pool_thread->thread.joinable())
+				pool_thread->thread.join();
+		}
 	}
 
 	std::shared_ptr<asio::io_service> ExecutorImpl::ioService() const
 	{
 		return io_service_;
 	}
+
+	std::shared_ptr<HandlerStatistics> ExecutorImpl::handlerStatistics() const
+	{
+		return handler_statistics_;
+	}
+
+	void ExecutorImpl::enableStatistics(std::chrono::milliseconds probe_interval)
+	{
+		std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+
+		const auto now = std::chrono::steady_clock::now();
+		statistics_start_time_ = now;
+		thread_records_.erase(std::remove_if(thread_records_.begin(), thread_records_.end(), 
+					[](const std::shared_ptr<ThreadRecord>& thread_record) { return !thread_record->running; }),
+				thread_records_.end());
+		for (const auto& thread_record : thread_records_)
+		{
+			thread_record->start_time = now;
+			thread_record->start_cpu_time = cpuTime(thread_record->cpu_clock);
+		}
+
+		queue_delay_samples_ = 0;
+		queue_delay_sum_ = std::chrono::nanoseconds(0);
+		queue_delay_last_ = std::chrono::nanoseconds(0);
+		queue_delay_max_ = std::chrono::nanoseconds(0);
+
+		handler_statistics_->reset();
+		handler_statistics_->setEnabled(true);
+
+		probe_interval_ = std::max(probe_interval, std::chrono::milliseconds(1));
+		statistics_enabled_ = true;
+		restartQueueDelayProbe();
+	}
+
+	void ExecutorImpl::disableStatistics()
+	{
+		std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+		statistics_enabled_ = false;
+		handler_statistics_->setEnabled(false);
+		restartQueueDelayProbe();
+	}
+
+	void ExecutorImpl::enableAutoScaling(const AutoScalingPolicy& policy)
+	{
+		size_t thread_count = getThreadCount();
+		{
+			std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+			auto_scaling_policy_ = policy;
+			auto_scaling_policy_.min_threads = std::max(policy.min_threads, size_t(1));
+			auto_scaling_policy_.max_threads = std::max(policy.max_threads, auto_scaling_policy_.min_threads);
+			auto_scaling_window_start_ = std::chrono::steady_clock::now();
+			auto_scaling_window_samples_ = 0;
+			auto_scaling_window_delay_sum_ = std::chrono::nanoseconds(0);
+			auto_scaling_enabled_ = true;
+
+			probe_interval_ = std::max(policy.probe_interval, std::chrono::milliseconds(1));
+			restartQueueDelayProbe();
+
+			thread_count = std::min(std::max(thread_count, auto_scaling_policy_.min_threads),
+					auto_scaling_policy_.max_threads);
+		}
+		setThreadCount(thread_count);
+	}
+
+	void ExecutorImpl::disableAutoScaling()
+	{
+		std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+		if (!auto_scaling_enabled_) return;
+		auto_scaling_enabled_ = false;
+		restartQueueDelayProbe();
+	}
+
+	ExecutorStatistics ExecutorImpl::getStatistics() const
+	{
+		ExecutorStatistics statistics;
+
+		std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+		const auto now = std::chrono::steady_clock::now();
+		statistics.measurement_time = now - statistics_start_time_;
+
+		statistics.queue_delay_samples = queue_delay_samples_;
+		statistics.queue_delay_last = queue_delay_last_;
+		statistics.queue_delay_max = queue_delay_max_;
+		if (queue_delay_samples_ > 0)
+			statistics.queue_delay_mean = queue_delay_sum_ / queue_delay_samples_;
+
+		for (const auto& thread_record : thread_records_)
+		{
+			// Threads that have exited before the measurement started are left out
+			if (!thread_record->running && (thread_record->end_time < statistics_start_time_))
+				continue;
+
+			ExecutorThreadStatistics thread_statistics;
+			thread_statistics.running = thread_record->running;
+
+			const auto start_time = std::max(thread_record->start_time, statistics_start_time_);
+			const auto end_time = (thread_record->running ? now : thread_record->end_time);
+			const auto end_cpu_time = (thread_record->running 
+					? cpuTime(thread_record->cpu_clock) : thread_record->end_cpu_time);
+
+			const std::chrono::nanoseconds wall_time = end_time - start_time;
+			thread_statistics.busy_time = std::min(end_cpu_time - thread_record->start_cpu_time, wall_time);
+			thread_statistics.idle_time = wall_time - thread_statistics.busy_time;
+			statistics.threads.push_back(thread_statistics);
+		}
+
+		statistics.handler_counts = handler_statistics_->getCounts();
+		return statistics;
+	}
+
+	void ExecutorImpl::restartQueueDelayProbe()
+	{
+		// Called with statistics_mutex_ held. Probes of the previous generation
+		// are ignored when they arrive.
+		statistics_generation_++;
+		if (statistics_enabled_ || auto_scaling_enabled_)
+		{
+			scheduleQueueDelayProbe();
+		}
+		else
+		{
+			system::error_code ec;
+			probe_timer_.cancel(ec);
+		}
+	}
+
+	void ExecutorImpl::scheduleQueueDelayProbe()
+	{
+		// Called with statistics_mutex_ held. The probe handlers do not keep the
+		// executor alive, it owns the io_service they are queued in.
+		// Measured from the expiry of the timer. Measuring from a post() made by
+		// the timer handler would miss the time the handler itself waited.
+		const auto expiry_time = std::chrono::steady_clock::now() + probe_interval_;
+		probe_timer_.expires_at(expiry_time);
+		probe_timer_.async_wait(
+				[weak_me = weak_from_this(), generation = statistics_generation_, expiry_time](system::error_code ec)
+				{
+					auto me = weak_me.lock();
+					if (!me || ec) return;
+
+					const auto queue_delay = std::chrono::steady_clock::now() - expiry_time;
+					me->recordQueueDelay(generation, std::max(queue_delay, std::chrono::steady_clock::duration(0)));
+				});
+	}
+
+	void ExecutorImpl::recordQueueDelay(uint64_t generation, std::chrono::nanoseconds queue_delay)
+	{
+		std::unique_lock<std::mutex> statistics_lock(statistics_mutex_);
+		if (generation != statistics_generation_) return;
+
+		if (statistics_enabled_)
+		{
+			queue_delay_samples_++;
+			queue_delay_sum_ += queue_delay;
+			queue_delay_last_ = queue_delay;
+			queue_delay_max_ = std::max(queue_delay_max_, queue_delay);
+		}
+
+		size_t thread_count = 0;
+		size_t new_thread_count = 0;
+		if (auto_scaling_enabled_)
+		{
+			auto_scaling_window_samples_++;
+			auto_scaling_window_delay_sum_ += queue_delay;
+
+			const auto now = std::chrono::steady_clock::now();
+			if (now - auto_scaling_window_start_ >= auto_scaling_policy_.evaluation_interval)
+			{
+				const auto mean_queue_delay = auto_scaling_window_delay_sum_ / auto_scaling_window_samples_;
+				thread_count = getThreadCount();
+				new_thread_count = thread_count;
+
+				if ((mean_queue_delay > auto_scaling_policy_.scale_up_queue_delay)
+						&& (thread_count < auto_scaling_policy_.max_threads))
+				{
+					new_thread_count++;
+				}
+				else if ((mean_queue_delay < auto_scaling_policy_.scale_down_queue_delay)
+						&& (thread_count > auto_scaling_policy_.min_threads))
+				{
+					new_thread_count--;
+				}
+
+				auto_scaling_window_start_ = now;
+				auto_scaling_window_samples_ = 0;
+				auto_scaling_window_delay_sum_ = std::chrono::nanoseconds(0);
+			}
+		}
+
+		scheduleQueueDelayProbe();
+		statistics_lock.unlock();
+
+		if (new_thread_count != thread_count)
+		{
+			std::cout << "Executor: Auto scaling from " << thread_count << " to " << new_thread_count << " threads" << std::endl;
+			setThreadCount(new_thread_count);
+		}
+	}
+
+	void ExecutorImpl::enableBufferMemory(const BufferMemoryPolicy& policy,
+			const std::shared_ptr<std::pmr::memory_resource>& upstream_resource)
+	{
+		auto buffer_memory = std::make_shared<BufferMemory>(policy, upstream_resource);
+
+		std::lock_guard<std::mutex> buffer_memory_lock(buffer_memory_mutex_);
+		buffer_memory_ = buffer_memory;
+		last_buffer_memory_ = buffer_memory;
+	}
+
+	void ExecutorImpl::disableBufferMemory()
+	{
+		std::lock_guard<std::mutex> buffer_memory_lock(buffer_memory_mutex_);
+		buffer_memory_.reset();
+	}
+
+	BufferMemoryStatistics ExecutorImpl::getBufferMemoryStatistics() const
+	{
+		std::shared_ptr<BufferMemory> buffer_memory;
+		{
+			std::lock_guard<std::mutex> buffer_memory_lock(buffer_memory_mutex_);
+			buffer_memory = last_buffer_memory_;
+		}
+		return (buffer_memory ? buffer_memory->getStatistics() : BufferMemoryStatistics());
+	}
+
+	std::shared_ptr<BufferMemoryComponent> ExecutorImpl::createBufferMemoryComponent(const std::string& name)
+	{
+		std::shared_ptr<BufferMemory> buffer_memory;
+		{
+			std::lock_guard<std::mutex> buffer_memory_lock(buffer_memory_mutex_);
+			buffer_memory = buffer_memory_;
+		}
+		return (buffer_memory ? buffer_memory->createComponent(name) : nullptr);
+	}
 } // namespace stps
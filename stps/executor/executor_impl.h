@@ -1,13 +1,23 @@
 #pragma once
 
+#include <stps/executor/auto_scaling_policy.h>
+#include <stps/executor/executor_statistics.h>
+#include <stps/executor/handler_statistics.h>
+#include <stps/memory/buffer_memory.h>
+
 #include <stdint.h>
+#include <time.h>
 
+#include <chrono>
 #include <thread>
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
 
-#include <boost/asio.hpp>
+#include <stps/boost_asio.h>
+#include <boost/asio/steady_timer.hpp>
 
 using namespace boost;
 
@@ -29,13 +39,107 @@ namespace stps
 
 			void start(size_t thread_count);
 			
+			// Stops the io_service and joins the threads. When called from one
+			// of the executor's own threads, the destructor joins them instead.
 			void stop();
 
+			// Adds threads or asks threads to leave io_service::run() and joins
+			// them. When called from one of the executor's own threads, the
+			// exiting threads are joined on a later call instead.
+			void setThreadCount(size_t thread_count);
+
+			size_t getThreadCount() const;
+
+			void enableAutoScaling(const AutoScalingPolicy& policy);
+
+			void disableAutoScaling();
+
 			std::shared_ptr<asio::io_service> ioService() const;
+
+			// Shared with the sessions, which count the handlers they run
+			std::shared_ptr<HandlerStatistics> handlerStatistics() const;
+
+			void enableStatistics(std::chrono::milliseconds probe_interval);
+
+			void disableStatistics();
+
+			ExecutorStatistics getStatistics() const;
+
+			void enableBufferMemory(const BufferMemoryPolicy& policy,
+					const std::shared_ptr<std::pmr::memory_resource>& upstream_resource);
+
+			void disableBufferMemory();
+
+			BufferMemoryStatistics getBufferMemoryStatistics() const;
+
+			// nullptr while the buffer memory is disabled
+			std::shared_ptr<BufferMemoryComponent> createBufferMemoryComponent(const std::string& name);
 		
 		private:
+			struct PoolThread
+			{
+				std::thread thread;
+				bool finished = false;
+			};
+
+			struct ThreadRecord
+			{
+				clockid_t cpu_clock;
+				bool running = true;
+				std::chrono::steady_clock::time_point start_time;
+				std::chrono::nanoseconds start_cpu_time{0};
+				std::chrono::steady_clock::time_point end_time;
+				std::chrono::nanoseconds end_cpu_time{0};
+			};
+
 			std::shared_ptr<asio::io_service>	io_service_;
-			std::vector<std::thread> thread_pool_;
 			std::shared_ptr<asio::io_service::work> dummy_work_;
+
+			// Protected by thread_pool_mutex_
+			mutable std::mutex thread_pool_mutex_;
+			std::condition_variable thread_exited_cv_;
+			std::vector<std::shared_ptr<PoolThread>> thread_pool_;
+			size_t thread_count_;
+			size_t pending_exit_tokens_;
+			bool stopped_;
+
+			const std::shared_ptr<HandlerStatistics> handler_statistics_;
+
+			// Protected by statistics_mutex_
+			mutable std::mutex statistics_mutex_;
+			std::vector<std::shared_ptr<ThreadRecord>> thread_records_;
+			bool statistics_enabled_;
+			uint64_t statistics_generation_;
+			std::chrono::steady_clock::time_point statistics_start_time_;
+			std::chrono::milliseconds probe_interval_;
+			asio::steady_timer probe_timer_;
+			uint64_t queue_delay_samples_;
+			std::chrono::nanoseconds queue_delay_sum_;
+			std::chrono::nanoseconds queue_delay_last_;
+			std::chrono::nanoseconds queue_delay_max_;
+			bool auto_scaling_enabled_;
+			AutoScalingPolicy auto_scaling_policy_;
+			std::chrono::steady_clock::time_point auto_scaling_window_start_;
+			uint64_t auto_scaling_window_samples_;
+			std::chrono::nanoseconds auto_scaling_window_delay_sum_;
+
+			// Protected by buffer_memory_mutex_
+			mutable std::mutex buffer_memory_mutex_;
+			std::shared_ptr<BufferMemory> buffer_memory_;
+			std::shared_ptr<BufferMemory> last_buffer_memory_;
+
+			void runThread(const std::shared_ptr<PoolThread>& pool_thread);
+
+			void joinFinishedThreads(std::unique_lock<std::mutex>& thread_pool_lock);
+
+			bool isPoolThread() const;
+
+			void restartQueueDelayProbe();
+
+			void scheduleQueueDelayProbe();
+
+			void evaluateAutoScaling(std::chrono::steady_clock::time_point now);
+
+			void recordQueueDelay(uint64_t generation, std::chrono::nanoseconds queue_delay);
 	};
 } // namespace stps
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <vector>
+
+namespace stps
+{
+	// Number of handlers the library has run on the executor, by source
+	struct HandlerCounts
+	{
+		uint64_t publisher_accept = 0;
+		uint64_t publisher_read = 0;
+		uint64_t publisher_write = 0;
+		uint64_t subscriber_connect = 0;
+		uint64_t subscriber_read = 0;
+		uint64_t subscriber_callback = 0;
+		uint64_t timer = 0;
+	};
+
+	struct ExecutorThreadStatistics
+	{
+		// CPU time of the thread and the rest of the measurement period. Time
+		// spent blocked on a lock counts as idle.
+		std::chrono::nanoseconds busy_time{0};
+		std::chrono::nanoseconds idle_time{0};
+		bool running = false;
+	};
+
+	// Collected since Executor::enableStatistics()
+	struct ExecutorStatistics
+	{
+		std::chrono::nanoseconds measurement_time{0};
+
+		// Delay between a probe timer expiring and its handler being run,
+		// sampled periodically. A growing delay means the pool is saturated.
+		uint64_t queue_delay_samples = 0;
+		std::chrono::nanoseconds queue_delay_last{0};
+		std::chrono::nanoseconds queue_delay_mean{0};
+		std::chrono::nanoseconds queue_delay_max{0};
+
+		std::vector<ExecutorThreadStatistics> threads;
+
+		HandlerCounts handler_counts;
+	};
+} // namespace stps
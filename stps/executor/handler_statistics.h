@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stps/executor/executor_statistics.h>
+
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+
+namespace stps
+{
+	enum class HandlerSource : uint8_t
+	{
+		PublisherAccept,
+		PublisherRead,
+		PublisherWrite,
+		SubscriberConnect,
+		SubscriberRead,
+		SubscriberCallback,
+		Timer,
+		Count
+	};
+
+	// Handler counters shared by the executor and the sessions running on it.
+	// Counting is a relaxed load while statistics are disabled.
+	class HandlerStatistics
+	{
+		public:
+			HandlerStatistics()
+				: enabled_(false)
+			{
+				reset();
+			}
+
+			void setEnabled(bool enabled)
+			{
+				enabled_.store(enabled, std::memory_order_relaxed);
+			}
+
+			bool isEnabled() const
+			{
+				return enabled_.load(std::memory_order_relaxed);
+			}
+
+			void count(HandlerSource source)
+			{
+				if (isEnabled())
+					counts_[static_cast<size_t>(source)].fetch_add(1, std::memory_order_relaxed);
+			}
+
+			void reset()
+			{
+				for (auto& count : counts_)
+					count.store(0, std::memory_order_relaxed);
+			}
+
+			HandlerCounts getCounts() const
+			{
+				HandlerCounts handler_counts;
+				handler_counts.publisher_accept    = load(HandlerSource::PublisherAccept);
+				handler_counts.publisher_read      = load(HandlerSource::PublisherRead);
+				handler_counts.publisher_write     = load(HandlerSource::PublisherWrite);
+				handler_counts.subscriber_connect  = load(HandlerSource::SubscriberConnect);
+				handler_counts.subscriber_read     = load(HandlerSource::SubscriberRead);
+				handler_counts.subscriber_callback = load(HandlerSource::SubscriberCallback);
+				handler_counts.timer               = load(HandlerSource::Timer);
+				return handler_counts;
+			}
+
+		private:
+			std::atomic<bool> enabled_;
+			std::array<std::atomic<uint64_t>, static_cast<size_t>(HandlerSource::Count)> counts_;
+
+			uint64_t load(HandlerSource source) const
+			{
+				return counts_[static_cast<size_t>(source)].load(std::memory_order_relaxed);
+			}
+	};
+} // namespace stps
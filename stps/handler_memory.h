@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stps/boost_asio.h>
+
+#include <stddef.h>
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace stps
+{
+// Memory for the handlers of a session's operations that are in flight one
+// at a time, e.g. its socket reads. asio caches the memory of one handler per
+// thread, a session with more operations in flight allocates for every
+// message otherwise. If the memory is in use or too small, the handler is
+// allocated on the heap.
+//
+// The handlers keep the session alive, so the memory outlives them.
+class HandlerMemory
+{
+    public:
+        HandlerMemory()
+            : in_use_(false)
+        {}
+
+        HandlerMemory(const HandlerMemory&) = delete;
+
+        HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+        void* allocate(size_t size)
+        {
+            if ((size <= sizeof(storage_)) && !in_use_.exchange(true, std::memory_order_acquire))
+                return &storage_;
+            return ::operator new(size);
+        }
+
+        void deallocate(void* pointer)
+        {
+            if (pointer == &storage_)
+                in_use_.store(false, std::memory_order_release);
+            else
+                ::operator delete(pointer);
+        }
+
+    private:
+        std::aligned_storage<1024>::type storage_;
+        // Released on the thread that completes the operation
+        std::atomic<bool> in_use_;
+};
+
+// A handler allocated from a HandlerMemory. Wrapping it in a strand keeps
+// the allocation hooks, asio's wrapped handler forwards them.
+template <typename Handler>
+class HandlerWithMemory
+{
+    public:
+        HandlerWithMemory(HandlerMemory& memory, Handler handler)
+            : memory_(&memory)
+            , handler_(std::move(handler))
+        {}
+
+        template <typename... Args>
+        void operator()(Args&&... args)
+        {
+            handler_(std::forward<Args>(args)...);
+        }
+
+        friend void* asio_handler_allocate(size_t size, HandlerWithMemory* this_handler)
+        {
+            return this_handler->memory_->allocate(size);
+        }
+
+        friend void asio_handler_deallocate(void* pointer, size_t /*size*/, HandlerWithMemory* this_handler)
+        {
+            this_handler->memory_->deallocate(pointer);
+        }
+
+    private:
+        HandlerMemory* memory_;
+        Handler handler_;
+};
+
+template <typename Handler>
+HandlerWithMemory<typename std::decay<Handler>::type> withHandlerMemory(HandlerMemory& memory, Handler&& handler)
+{
+    return HandlerWithMemory<typename std::decay<Handler>::type>(memory, std::forward<Handler>(handler));
+}
+} // namespace stps
@@ -0,0 +1,201 @@
+#include <stps/memory/buffer_arena.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+
+// Older headers do not define the huge page size flags of mmap()
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace stps
+{
+namespace
+{
+    size_t roundUp(size_t bytes, size_t multiple)
+    {
+        return ((bytes + multiple - 1) / multiple) * multiple;
+    }
+} // namespace
+
+BufferArena::BufferArena(const BufferArenaPolicy& policy)
+    : arena_(nullptr)
+    , arena_bytes_(0)
+    , used_bytes_(0)
+    , warm_bytes_(0)
+    , huge_pages_(false)
+    , locked_(false)
+    , upstream_allocations_(0)
+{
+    mapArena(policy);
+    warmUp(policy);
+}
+
+BufferArena::~BufferArena()
+{
+    if (arena_)
+        munmap(arena_, arena_bytes_);
+}
+
+void BufferArena::mapArena(const BufferArenaPolicy& policy)
+{
+    const size_t arena_bytes = std::max(policy.arena_bytes, kMinBlockSize);
+
+    if (policy.huge_page_size != HugePageSize::None)
+    {
+        const bool gigabyte_pages = (policy.huge_page_size == HugePageSize::Size1GB);
+        const size_t huge_page_bytes = (gigabyte_pages ? size_t(1) << 30 : size_t(1) << 21);
+        const int huge_page_flags = MAP_HUGETLB | (gigabyte_pages ? MAP_HUGE_1GB : MAP_HUGE_2MB);
+
+        void* mapping = mmap(nullptr, roundUp(arena_bytes, huge_page_bytes), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | huge_page_flags, -1, 0);
+        if (mapping != MAP_FAILED)
+        {
+            arena_ = static_cast<char*>(mapping);
+            arena_bytes_ = roundUp(arena_bytes, huge_page_bytes);
+            huge_pages_ = true;
+            return;
+        }
+
+        std::cout << "BufferArena: Failed mapping huge pages: " << strerror(errno) 
+            << ". Using regular pages." << std::endl;
+    }
+
+    const size_t page_bytes = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void* mapping = mmap(nullptr, roundUp(arena_bytes, page_bytes), PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        std::cout << "BufferArena: Failed mapping the arena: " << strerror(errno) 
+            << ". Buffers are allocated from the heap." << std::endl;
+        return;
+    }
+
+    arena_ = static_cast<char*>(mapping);
+    arena_bytes_ = roundUp(arena_bytes, page_bytes);
+
+    // Transparent huge pages, where enabled
+    madvise(arena_, arena_bytes_, MADV_HUGEPAGE);
+}
+
+void BufferArena::warmUp(const BufferArenaPolicy& policy)
+{
+    if (!arena_) return;
+
+    // Blocks are carved from the start of the arena, so the first buffers
+    // land in the warm part
+    const size_t page_bytes = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    warm_bytes_ = std::min(roundUp(policy.warm_up_bytes, page_bytes), arena_bytes_);
+    for (size_t offset = 0; offset < warm_bytes_; offset += page_bytes)
+        static_cast<volatile char*>(arena_)[offset] = 0;
+
+    if (policy.lock_memory && (warm_bytes_ > 0))
+    {
+        if (mlock(arena_, warm_bytes_) == 0)
+        {
+            locked_ = true;
+        }
+        else
+        {
+            std::cout << "BufferArena: Failed locking " << warm_bytes_ << " bytes: " << strerror(errno)
+                << ". Check RLIMIT_MEMLOCK." << std::endl;
+        }
+    }
+}
+
+void* BufferArena::do_allocate(size_t bytes, size_t alignment)
+{
+    const size_t size_class = sizeClass(bytes);
+    if (arena_ && (alignment <= kMinBlockSize) && (size_class < kSizeClassCount))
+    {
+        const size_t block_bytes = kMinBlockSize << size_class;
+
+        std::lock_guard<std::mutex> arena_lock(arena_mutex_);
+        std::vector<void*>& free_blocks = free_blocks_[size_class];
+        if (!free_blocks.empty())
+        {
+            void* block = free_blocks.back();
+            free_blocks.pop_back();
+            return block;
+        }
+
+        if (block_bytes <= arena_bytes_ - used_bytes_)
+        {
+            void* block = arena_ + used_bytes_;
+            used_bytes_ += block_bytes;
+            return block;
+        }
+
+        upstream_allocations_++;
+    }
+
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void BufferArena::do_deallocate(void* pointer, size_t bytes, size_t alignment)
+{
+    if (isInArena(pointer))
+    {
+        std::lock_guard<std::mutex> arena_lock(arena_mutex_);
+        free_blocks_[sizeClass(bytes)].push_back(pointer);
+        return;
+    }
+
+    std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+}
+
+bool BufferArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+BufferArenaStatistics BufferArena::getStatistics() const
+{
+    std::lock_guard<std::mutex> arena_lock(arena_mutex_);
+    BufferArenaStatistics statistics;
+    statistics.arena_bytes = arena_bytes_;
+    statistics.used_bytes = used_bytes_;
+    statistics.warm_bytes = warm_bytes_;
+    statistics.huge_pages = huge_pages_;
+    statistics.locked = locked_;
+    statistics.upstream_allocations = upstream_allocations_;
+    return statistics;
+}
+
+std::shared_ptr<Buffer> BufferArena::createBuffer(const std::shared_ptr<BufferArena>& buffer_arena)
+{
+    if (!buffer_arena) return std::make_shared<Buffer>();
+
+    // The buffer keeps the arena alive
+    return std::shared_ptr<Buffer>(new Buffer(buffer_arena.get()), 
+            [buffer_arena](Buffer* buffer)
+            {
+                delete buffer;
+            });
+}
+
+size_t BufferArena::sizeClass(size_t bytes)
+{
+    size_t size_class = 0;
+    while ((size_class < kSizeClassCount) && ((kMinBlockSize << size_class) < bytes))
+        size_class++;
+    return size_class;
+}
+
+bool BufferArena::isInArena(const void* pointer) const
+{
+    const char* const address = static_cast<const char*>(pointer);
+    return arena_ && (address >= arena_) && (address < arena_ + arena_bytes_);
+}
+} // namespace stps
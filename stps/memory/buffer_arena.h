@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stps/buffer.h>
+#include <stps/memory/buffer_arena_policy.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace stps
+{
+struct BufferArenaStatistics
+{
+    size_t arena_bytes = 0;
+
+    // Carved from the arena so far, idle blocks included
+    size_t used_bytes = 0;
+
+    // Pre-faulted and, if requested, locked at creation
+    size_t warm_bytes = 0;
+
+    bool huge_pages = false;
+    bool locked = false;
+
+    // Served by the heap because the arena was exhausted
+    uint64_t upstream_allocations = 0;
+};
+
+// Memory resource for message buffers, carved from one pre-faulted and
+// optionally locked (huge page) mapping. Blocks are rounded up to a power of
+// two and kept on a free list of their size when released, the arena never
+// returns memory to the system. When it is exhausted, the heap is used.
+//
+// Given to Publisher::setBufferArena() or Subscriber::setBufferArena(). Every
+// buffer keeps the arena alive, so it may be shared and outlive its users.
+class BufferArena : public std::pmr::memory_resource
+{
+    public:
+        explicit BufferArena(const BufferArenaPolicy& policy = BufferArenaPolicy());
+
+        ~BufferArena() override;
+
+        BufferArena(const BufferArena&) = delete;
+
+        BufferArena& operator=(const BufferArena&) = delete;
+
+        BufferArenaStatistics getStatistics() const;
+
+        // A buffer using the arena, or the heap for nullptr
+        static std::shared_ptr<Buffer> createBuffer(const std::shared_ptr<BufferArena>& buffer_arena);
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    private:
+        // Every block is a multiple of the smallest one, which keeps all
+        // blocks aligned to it
+        static constexpr size_t kMinBlockSize = 64;
+        static constexpr size_t kSizeClassCount = 48;
+
+        mutable std::mutex arena_mutex_;
+        char* arena_;
+        size_t arena_bytes_;
+        size_t used_bytes_;
+        size_t warm_bytes_;
+        bool huge_pages_;
+        bool locked_;
+        uint64_t upstream_allocations_;
+        std::array<std::vector<void*>, kSizeClassCount> free_blocks_;
+
+        void mapArena(const BufferArenaPolicy& policy);
+
+        void warmUp(const BufferArenaPolicy& policy);
+
+        static size_t sizeClass(size_t bytes);
+
+        bool isInArena(const void* pointer) const;
+};
+} // namespace stps
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace stps
+{
+    enum class HugePageSize : uint8_t
+    {
+        // Regular pages, transparent huge pages are requested with madvise()
+        None,
+        Size2MB,
+        Size1GB,
+    };
+
+    // The arena is reserved once. Its first warm_up_bytes are faulted in (and
+    // locked with lock_memory) when it is created, so the first buffers do not
+    // pay for page faults. Huge pages must be reserved by the administrator
+    // (vm.nr_hugepages); without them the arena falls back to regular pages.
+    struct BufferArenaPolicy
+    {
+        size_t arena_bytes = 64 * 1024 * 1024;
+        HugePageSize huge_page_size = HugePageSize::Size2MB;
+        size_t warm_up_bytes = 16 * 1024 * 1024;
+        bool lock_memory = true;
+    };
+} // namespace stps
@@ -0,0 +1,173 @@
+#include <stps/memory/buffer_memory.h>
+
+#include <algorithm>
+#include <new>
+
+namespace stps
+{
+BufferMemoryComponent::BufferMemoryComponent(const std::shared_ptr<BufferMemory>& buffer_memory, 
+        const std::string& name)
+    : buffer_memory_(buffer_memory)
+    , name_(name)
+    , allocated_bytes_(0)
+    , peak_allocated_bytes_(0)
+    , failed_allocations_(0)
+{
+}
+
+std::shared_ptr<Buffer> BufferMemoryComponent::createBuffer(const std::shared_ptr<BufferMemoryComponent>& component)
+{
+    return std::shared_ptr<Buffer>(new Buffer(component.get()),
+            [component](Buffer* buffer)
+            {
+                delete buffer;
+            });
+}
+
+void* BufferMemoryComponent::do_allocate(size_t bytes, size_t alignment)
+{
+    void* pointer;
+    try
+    {
+        pointer = buffer_memory_->pool_resource_.allocate(bytes, alignment);
+    }
+    catch (const std::bad_alloc&)
+    {
+        failed_allocations_.fetch_add(1, std::memory_order_relaxed);
+        throw;
+    }
+
+    const size_t allocated_bytes = allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak_allocated_bytes = peak_allocated_bytes_.load(std::memory_order_relaxed);
+    while ((allocated_bytes > peak_allocated_bytes) 
+            && !peak_allocated_bytes_.compare_exchange_weak(peak_allocated_bytes, allocated_bytes, 
+                std::memory_order_relaxed)) {}
+
+    return pointer;
+}
+
+void BufferMemoryComponent::do_deallocate(void* pointer, size_t bytes, size_t alignment)
+{
+    buffer_memory_->pool_resource_.deallocate(pointer, bytes, alignment);
+    allocated_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool BufferMemoryComponent::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+BufferMemoryComponentStatistics BufferMemoryComponent::getStatistics() const
+{
+    BufferMemoryComponentStatistics statistics;
+    statistics.name = name_;
+    statistics.allocated_bytes = allocated_bytes_.load(std::memory_order_relaxed);
+    statistics.peak_allocated_bytes = peak_allocated_bytes_.load(std::memory_order_relaxed);
+    statistics.failed_allocations = failed_allocations_.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+BufferMemory::BudgetResource::BudgetResource(size_t budget_bytes, std::pmr::memory_resource* upstream_resource)
+    : budget_bytes_(budget_bytes)
+    , upstream_resource_(upstream_resource)
+    , upstream_bytes_(0)
+    , failed_allocations_(0)
+{
+}
+
+size_t BufferMemory::BudgetResource::getUpstreamBytes() const
+{
+    return upstream_bytes_.load(std::memory_order_relaxed);
+}
+
+uint64_t BufferMemory::BudgetResource::getFailedAllocations() const
+{
+    return failed_allocations_.load(std::memory_order_relaxed);
+}
+
+void* BufferMemory::BudgetResource::do_allocate(size_t bytes, size_t alignment)
+{
+    // Reserved before allocating, so concurrent allocations cannot overshoot
+    const size_t upstream_bytes = upstream_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if ((budget_bytes_ > 0) && (upstream_bytes > budget_bytes_))
+    {
+        upstream_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        failed_allocations_.fetch_add(1, std::memory_order_relaxed);
+        throw std::bad_alloc();
+    }
+
+    try
+    {
+        return upstream_resource_->allocate(bytes, alignment);
+    }
+    catch (...)
+    {
+        upstream_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        failed_allocations_.fetch_add(1, std::memory_order_relaxed);
+        throw;
+    }
+}
+
+void BufferMemory::BudgetResource::do_deallocate(void* pointer, size_t bytes, size_t alignment)
+{
+    upstream_resource_->deallocate(pointer, bytes, alignment);
+    upstream_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool BufferMemory::BudgetResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+namespace
+{
+    std::pmr::pool_options poolOptions(const BufferMemoryPolicy& policy)
+    {
+        std::pmr::pool_options pool_options;
+        pool_options.largest_required_pool_block = policy.largest_pooled_block_bytes;
+        return pool_options;
+    }
+} // namespace
+
+BufferMemory::BufferMemory(const BufferMemoryPolicy& policy, 
+        const std::shared_ptr<std::pmr::memory_resource>& upstream_resource)
+    : policy_(policy)
+    , upstream_resource_(upstream_resource)
+    , budget_resource_(policy.budget_bytes, 
+            (upstream_resource ? upstream_resource.get() : std::pmr::new_delete_resource()))
+    , pool_resource_(poolOptions(policy), &budget_resource_)
+{
+}
+
+std::shared_ptr<BufferMemoryComponent> BufferMemory::createComponent(const std::string& name)
+{
+    auto component = std::make_shared<BufferMemoryComponent>(shared_from_this(), name);
+
+    std::lock_guard<std::mutex> components_lock(components_mutex_);
+    components_.erase(std::remove_if(components_.begin(), components_.end(),
+                [](const std::weak_ptr<BufferMemoryComponent>& component) -> bool
+                {
+                    return component.expired();
+                }), components_.end());
+    components_.push_back(component);
+    return component;
+}
+
+BufferMemoryStatistics BufferMemory::getStatistics() const
+{
+    BufferMemoryStatistics statistics;
+    statistics.enabled = true;
+    statistics.budget_bytes = policy_.budget_bytes;
+    statistics.upstream_bytes = budget_resource_.getUpstreamBytes();
+    statistics.failed_allocations = budget_resource_.getFailedAllocations();
+
+    std::lock_guard<std::mutex> components_lock(components_mutex_);
+    for (const auto& weak_component : components_)
+    {
+        const auto component = weak_component.lock();
+        if (component)
+            statistics.components.push_back(component->getStatistics());
+    }
+    return statistics;
+}
+} // namespace stps
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stps/buffer.h>
+#include <stps/memory/buffer_memory_policy.h>
+#include <stps/memory/buffer_memory_statistics.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stps
+{
+class BufferMemory;
+
+// The memory resource of one publisher or subscriber, accounting its share of
+// the executor's buffer memory
+class BufferMemoryComponent : public std::pmr::memory_resource
+{
+    public:
+        BufferMemoryComponent(const std::shared_ptr<BufferMemory>& buffer_memory, const std::string& name);
+
+        BufferMemoryComponent(const BufferMemoryComponent&) = delete;
+
+        BufferMemoryComponent& operator=(const BufferMemoryComponent&) = delete;
+
+        // The buffer keeps the component, and with it the buffer memory, alive
+        static std::shared_ptr<Buffer> createBuffer(const std::shared_ptr<BufferMemoryComponent>& component);
+
+        BufferMemoryComponentStatistics getStatistics() const;
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    private:
+        const std::shared_ptr<BufferMemory> buffer_memory_;
+        const std::string name_;
+        std::atomic<size_t> allocated_bytes_;
+        std::atomic<size_t> peak_allocated_bytes_;
+        std::atomic<uint64_t> failed_allocations_;
+};
+
+// Executor wide buffer memory: pools shared by all components on top of the
+// budget enforcing upstream resource
+class BufferMemory : public std::enable_shared_from_this<BufferMemory>
+{
+    public:
+        // nullptr upstream_resource uses the heap
+        BufferMemory(const BufferMemoryPolicy& policy, 
+                const std::shared_ptr<std::pmr::memory_resource>& upstream_resource);
+
+        BufferMemory(const BufferMemory&) = delete;
+
+        BufferMemory& operator=(const BufferMemory&) = delete;
+
+        std::shared_ptr<BufferMemoryComponent> createComponent(const std::string& name);
+
+        BufferMemoryStatistics getStatistics() const;
+
+    private:
+        friend BufferMemoryComponent;
+
+        // Counts the bytes taken from the upstream resource and refuses
+        // allocations beyond the budget
+        class BudgetResource : public std::pmr::memory_resource
+        {
+            public:
+                BudgetResource(size_t budget_bytes, std::pmr::memory_resource* upstream_resource);
+
+                size_t getUpstreamBytes() const;
+
+                uint64_t getFailedAllocations() const;
+
+            protected:
+                void* do_allocate(size_t bytes, size_t alignment) override;
+
+                void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+
+                bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+            private:
+                const size_t budget_bytes_;
+                std::pmr::memory_resource* const upstream_resource_;
+                std::atomic<size_t> upstream_bytes_;
+                std::atomic<uint64_t> failed_allocations_;
+        };
+
+        const BufferMemoryPolicy policy_;
+        const std::shared_ptr<std::pmr::memory_resource> upstream_resource_;
+        BudgetResource budget_resource_;
+        std::pmr::synchronized_pool_resource pool_resource_;
+
+        // Protected by components_mutex_
+        mutable std::mutex components_mutex_;
+        std::vector<std::weak_ptr<BufferMemoryComponent>> components_;
+};
+} // namespace stps
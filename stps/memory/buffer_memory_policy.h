@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace stps
+{
+    // Memory shared by all publishers and subscribers of an executor (see
+    // Executor::enableBufferMemory()). Released buffers go to pools of the
+    // executor, where any publisher or subscriber can reuse them.
+    struct BufferMemoryPolicy
+    {
+        // Bytes taken from the upstream resource, idle pooled memory
+        // included. An allocation beyond it fails: the publisher's send()
+        // returns false, the subscriber skips the message. 0 for no limit.
+        size_t budget_bytes = 0;
+
+        // Larger buffers are not pooled but taken from the upstream resource
+        // directly
+        size_t largest_pooled_block_bytes = 1024 * 1024;
+    };
+} // namespace stps
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace stps
+{
+    // Buffers of one publisher or subscriber
+    struct BufferMemoryComponentStatistics
+    {
+        std::string name;
+        size_t allocated_bytes = 0;
+        size_t peak_allocated_bytes = 0;
+        uint64_t failed_allocations = 0;
+    };
+
+    struct BufferMemoryStatistics
+    {
+        bool enabled = false;
+        size_t budget_bytes = 0;
+
+        // Taken from the upstream resource, idle pooled memory included
+        size_t upstream_bytes = 0;
+
+        // Allocations refused because of the budget
+        uint64_t failed_allocations = 0;
+
+        // Publishers and subscribers that still exist or whose buffers do
+        std::vector<BufferMemoryComponentStatistics> components;
+    };
+} // namespace stps
@@ -4,11 +4,54 @@
 
 namespace stps
 {
+// Protocol versions
+//   0: Initial version
+//   1: TCPHeader carries the sequence number of regular payload frames
+//   2: Credit based flow control, requested by the subscriber in its
+//      handshake and granted with CreditGrant messages
+//   3: Downsampling, requested by the subscriber in its handshake
+//   4: Striping a session across several connections
+//
+// Both sides send their version; the lower one is used. Headers may grow in
+// any version, receivers skip the part of a header they do not know.
+constexpr uint8_t kProtocolVersion = 4;
+
 #pragma pack(push, 1)
 
 struct ProtocolHandshakeMessage
 {
     uint8_t protocol_version = 0;
+
+    // Since version 2, only set by the subscriber. The publisher may send this
+    // many regular payload frames and bytes (frames including their headers)
+    // ahead of the credit granted by CreditGrant messages. 0 means unlimited;
+    // both 0 disables flow control.
+    uint64_t credit_window_messages = 0;
+    uint64_t credit_window_bytes = 0;
+
+    // Since version 3, only set by the subscriber. The publisher sends only
+    // every Nth regular payload buffer and at most one per interval. 0 (and 1
+    // for every_nth) disables the respective limit.
+    uint64_t downsampling_every_nth = 0;
+    uint64_t downsampling_interval_us = 0;
+
+    // Since version 4, only set by the subscriber. The connection is stripe
+    // stripe_index of stripe_count connections of one subscriber session and
+    // only gets the buffers whose first sequence number modulo stripe_count
+    // is stripe_index. A stripe_count of 0 or 1 gets every buffer.
+    uint32_t stripe_index = 0;
+    uint32_t stripe_count = 0;
+
+    // Since version 4, only set by the publisher. The sequence number of the
+    // next regular payload frame at the time of the handshake.
+    uint64_t next_sequence_number = 0;
+};
+
+// Since version 2. Sent by the subscriber for the frames it has consumed.
+struct CreditGrantMessage
+{
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
 };
 
 #pragma pack(pop)
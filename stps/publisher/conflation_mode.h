@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace stps
+{
+
+enum class ConflationMode : uint8_t
+{
+	// The send queue keeps the newest messages up to the send queue size
+	None = 0,
+
+	// The send queue keeps the newest message per key. A message replaces the
+	// queued message with the same key at its position in the queue. Messages
+	// sent without a key share one key. The send queue size does not apply.
+	Keyed = 1
+};
+
+} // namespace stps
@@ -0,0 +1,27 @@
+#include <stps/publisher/egress_limiter.h>
+#include <stps/publisher/egress_limiter_impl.h>
+#include <stps/executor/executor_impl.h>
+
+namespace stps
+{
+EgressLimiter::EgressLimiter(const std::shared_ptr<Executor>& executor, const EgressLimiterPolicy& policy)
+    : egress_limiter_impl_(std::make_shared<EgressLimiterImpl>(executor->executor_impl_->ioService(),
+                executor->executor_impl_->handlerStatistics(), policy))
+{
+}
+
+EgressLimiter::~EgressLimiter()
+{
+    egress_limiter_impl_->cancel();
+}
+
+void EgressLimiter::setPolicy(const EgressLimiterPolicy& policy)
+{
+    egress_limiter_impl_->setPolicy(policy);
+}
+
+EgressLimiterPolicy EgressLimiter::getPolicy() const
+{
+    return egress_limiter_impl_->getPolicy();
+}
+} // namespace stps
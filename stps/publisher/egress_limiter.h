@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stps/executor/executor.h>
+
+#include <memory>
+
+#include <stdint.h>
+
+namespace stps
+{
+    class EgressLimiterImpl;
+    class PublisherImpl;
+
+    struct EgressLimiterPolicy
+    {
+        // 0 disables the limit
+        uint64_t bytes_per_second = 0;
+
+        // Bytes that may be sent at once after the limiter has been idle.
+        // Also the quantum of the round robin between the sessions.
+        uint64_t burst_bytes = 64 * 1024;
+    };
+
+    // Token bucket shaping the egress bandwidth of the publishers it is set
+    // on. Share one limiter between publishers, e.g. all publishers of an
+    // executor, to limit them together.
+    //
+    // Subscriber sessions waiting for tokens are served with deficit round
+    // robin: every round, each busy session may send burst_bytes, and what it
+    // does not use is carried over until its send queue runs empty. So every
+    // busy session gets about the same number of bytes no matter how large
+    // its messages are. A frame is never split: one larger than the remaining
+    // tokens is sent and repaid afterwards.
+    class EgressLimiter
+    {
+        public:
+            EgressLimiter(const std::shared_ptr<Executor>& executor,
+                    const EgressLimiterPolicy& policy = EgressLimiterPolicy());
+
+            ~EgressLimiter();
+
+            EgressLimiter(const EgressLimiter&) = delete;
+
+            EgressLimiter& operator=(const EgressLimiter&) = delete;
+
+            void setPolicy(const EgressLimiterPolicy& policy);
+
+            EgressLimiterPolicy getPolicy() const;
+
+        private:
+            friend ::stps::PublisherImpl;
+            std::shared_ptr<EgressLimiterImpl> egress_limiter_impl_;
+    };
+} // namespace stps
@@ -0,0 +1,218 @@
+#include <stps/publisher/egress_limiter_impl.h>
+
+#include <algorithm>
+
+namespace stps
+{
+EgressLimiterImpl::EgressLimiterImpl(const std::shared_ptr<asio::io_service>& io_service, 
+        const std::shared_ptr<HandlerStatistics>& handler_statistics,
+        const EgressLimiterPolicy& policy)
+    : io_service_(io_service)
+    , handler_statistics_(handler_statistics)
+    , policy_(policy)
+    , tokens_(static_cast<double>(policy.burst_bytes))
+    , last_refill_(std::chrono::steady_clock::now())
+    , refill_timer_(*io_service_)
+    , refill_timer_armed_(false)
+    , canceled_(false)
+{
+}
+
+void EgressLimiterImpl::setPolicy(const EgressLimiterPolicy& policy)
+{
+    std::vector<std::function<void()>> send_handlers;
+    {
+        std::lock_guard<std::mutex> limiter_lock(limiter_mutex_);
+        refill();
+        policy_ = policy;
+        tokens_ = std::min(tokens_, static_cast<double>(policy_.burst_bytes));
+        send_handlers = dispatchWaiters();
+        armRefillTimer();
+    }
+
+    for (const auto& send_handler : send_handlers)
+        send_handler();
+}
+
+EgressLimiterPolicy EgressLimiterImpl::getPolicy() const
+{
+    std::lock_guard<std::mutex> limiter_lock(limiter_mutex_);
+    return policy_;
+}
+
+bool EgressLimiterImpl::acquire(const void* sender, size_t bytes, const std::function<void()>& send_handler)
+{
+    std::vector<std::function<void()>> send_handlers;
+    {
+        std::lock_guard<std::mutex> limiter_lock(limiter_mutex_);
+
+        if (canceled_ || (policy_.bytes_per_second == 0)) return true;
+
+        refill();
+        Sender& sender_state = senders_[sender];
+
+        // The deficit left from the sender's turn covers the frame. This may
+        // take the tokens below 0, the next round waits until that is repaid.
+        if (sender_state.deficit >= bytes)
+        {
+            sender_state.deficit -= bytes;
+            tokens_ -= static_cast<double>(bytes);
+            return true;
+        }
+
+        // The only busy sender is limited by the tokens alone
+        if ((senders_.size() == 1) && (tokens_ > 0.0))
+        {
+            tokens_ -= static_cast<double>(bytes);
+            return true;
+        }
+
+        sender_state.waiting = true;
+        sender_state.bytes = bytes;
+        sender_state.send_handler = send_handler;
+        waiters_.push_back(sender);
+        send_handlers = dispatchWaiters();
+        armRefillTimer();
+    }
+
+    postSendHandlers(send_handlers);
+    return false;
+}
+
+void EgressLimiterImpl::release(const void* sender)
+{
+    std::vector<std::function<void()>> send_handlers;
+    {
+        std::lock_guard<std::mutex> limiter_lock(limiter_mutex_);
+
+        const auto sender_it = senders_.find(sender);
+        if (sender_it == senders_.end()) return;
+        if (sender_it->second.waiting)
+            waiters_.erase(std::find(waiters_.begin(), waiters_.end(), sender));
+        senders_.erase(sender_it);
+
+        // The round may have been waiting for this sender to come back
+        if (canceled_) return;
+        refill();
+        send_handlers = dispatchWaiters();
+        armRefillTimer();
+    }
+
+    postSendHandlers(send_handlers);
+}
+
+void EgressLimiterImpl::cancel()
+{
+    std::vector<std::function<void()>> send_handlers;
+    {
+        std::lock_guard<std::mutex> limiter_lock(limiter_mutex_);
+        canceled_ = true;
+        system::error_code ec;
+        refill_timer_.cancel(ec);
+        for (const void* waiter : waiters_)
+            send_handlers.push_back(std::move(senders_[waiter].send_handler));
+        waiters_.clear();
+        senders_.clear();
+    }
+
+    for (const auto& send_handler : send_handlers)
+        send_handler();
+}
+
+void EgressLimiterImpl::refill()
+{
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed_seconds = std::chrono::duration<double>(now - last_refill_).count();
+    last_refill_ = now;
+    tokens_ = std::min(tokens_ + elapsed_seconds * static_cast<double>(policy_.bytes_per_second),
+            static_cast<double>(policy_.burst_bytes));
+}
+
+std::vector<std::function<void()>> EgressLimiterImpl::dispatchWaiters()
+{
+    std::vector<std::function<void()>> send_handlers;
+    if (waiters_.empty()) return send_handlers;
+
+    if (policy_.bytes_per_second == 0)
+    {
+        for (const void* waiter : waiters_)
+        {
+            Sender& sender_state = senders_[waiter];
+            sender_state.waiting = false;
+            send_handlers.push_back(std::move(sender_state.send_handler));
+        }
+        waiters_.clear();
+        return send_handlers;
+    }
+
+    // Deficit round robin with a fixed quantum. Every busy sender gets a
+    // quantum per round and sends once its deficit covers its frame; the rest
+    // of the deficit is spent on its next frames. The next round starts once
+    // every busy sender waits again (or released) and the tokens spent in
+    // this one have been repaid.
+    const uint64_t quantum = std::max<uint64_t>(policy_.burst_bytes, 1);
+
+    while (!waiters_.empty() && (waiters_.size() == senders_.size()) && (tokens_ > 0.0))
+    {
+        const size_t round_size = waiters_.size();
+        for (size_t i = 0; i < round_size; i++)
+        {
+            const void* waiter = waiters_.front();
+            waiters_.pop_front();
+
+            Sender& sender_state = senders_[waiter];
+            sender_state.deficit += quantum;
+            if (sender_state.deficit >= sender_state.bytes)
+            {
+                sender_state.deficit -= sender_state.bytes;
+                sender_state.waiting = false;
+                tokens_ -= static_cast<double>(sender_state.bytes);
+                send_handlers.push_back(std::move(sender_state.send_handler));
+            }
+            else
+            {
+                waiters_.push_back(waiter);
+            }
+        }
+    }
+    return send_handlers;
+}
+
+void EgressLimiterImpl::postSendHandlers(std::vector<std::function<void()>>& send_handlers)
+{
+    for (auto& send_handler : send_handlers)
+        asio::post(*io_service_, std::move(send_handler));
+}
+
+void EgressLimiterImpl::armRefillTimer()
+{
+    if (refill_timer_armed_ || canceled_ || waiters_.empty() || (policy_.bytes_per_second == 0)) return;
+
+    // With tokens left, the round waits for the busy senders instead
+    if (tokens_ > 0.0) return;
+
+    // Until a quarter of the burst is available, refilling for every single
+    // frame would fire the timer as often as frames are sent
+    const double refill_bytes = std::max(static_cast<double>(policy_.burst_bytes) / 4.0, 1.0);
+    const double seconds = (std::max(-tokens_, 0.0) + refill_bytes) / static_cast<double>(policy_.bytes_per_second);
+    refill_timer_armed_ = true;
+    refill_timer_.expires_after(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::duration<double>(seconds)));
+    refill_timer_.async_wait([me = shared_from_this()](system::error_code ec)
+            {
+                me->handler_statistics_->count(HandlerSource::Timer);
+                std::vector<std::function<void()>> send_handlers;
+                {
+                    std::lock_guard<std::mutex> limiter_lock(me->limiter_mutex_);
+                    me->refill_timer_armed_ = false;
+                    if (ec || me->canceled_) return;
+                    me->refill();
+                    send_handlers = me->dispatchWaiters();
+                    me->armRefillTimer();
+                }
+
+                for (const auto& send_handler : send_handlers)
+                    send_handler();
+            });
+}
+} // namespace stps
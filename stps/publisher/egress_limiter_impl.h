@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stps/publisher/egress_limiter.h>
+#include <stps/executor/handler_statistics.h>
+
+#include <stps/boost_asio.h>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace boost;
+
+namespace stps
+{
+    class EgressLimiterImpl : public std::enable_shared_from_this<EgressLimiterImpl>
+    {
+        public:
+            EgressLimiterImpl(const std::shared_ptr<asio::io_service>& io_service, 
+                    const std::shared_ptr<HandlerStatistics>& handler_statistics,
+                    const EgressLimiterPolicy& policy);
+
+            EgressLimiterImpl(const EgressLimiterImpl&) = delete;
+
+            EgressLimiterImpl& operator=(const EgressLimiterImpl&) = delete;
+
+            void setPolicy(const EgressLimiterPolicy& policy);
+
+            EgressLimiterPolicy getPolicy() const;
+
+            // Returns true if the bytes may be sent right away. Otherwise
+            // send_handler is called from an executor thread once they may.
+            // A sender, e.g. a publisher session, waits for one send at a
+            // time and keeps its deficit until it calls release().
+            bool acquire(const void* sender, size_t bytes, const std::function<void()>& send_handler);
+
+            // The sender has nothing left to send (or is closed). Resets its
+            // deficit and drops a send it may still be waiting for.
+            void release(const void* sender);
+
+            // Releases the waiting senders
+            void cancel();
+
+        private:
+            struct Sender
+            {
+                // Bytes the sender may send ahead of its turn, carried over
+                // from round to round while it is busy
+                uint64_t deficit = 0;
+
+                bool waiting = false;
+                size_t bytes = 0;
+                std::function<void()> send_handler;
+            };
+
+            std::shared_ptr<asio::io_service> io_service_;
+            const std::shared_ptr<HandlerStatistics> handler_statistics_;
+
+            mutable std::mutex limiter_mutex_;
+            EgressLimiterPolicy policy_;
+            double tokens_;
+            std::chrono::steady_clock::time_point last_refill_;
+            std::map<const void*, Sender> senders_;
+            // The waiting senders in round robin order
+            std::deque<const void*> waiters_;
+            asio::steady_timer refill_timer_;
+            bool refill_timer_armed_;
+            bool canceled_;
+
+            void refill();
+
+            // Removes the waiters that may send now and returns their handlers
+            std::vector<std::function<void()>> dispatchWaiters();
+
+            // Calls the handlers from an executor thread, the caller may hold
+            // locks of its own
+            void postSendHandlers(std::vector<std::function<void()>>& send_handlers);
+
+            void armRefillTimer();
+    };
+} // namespace stps
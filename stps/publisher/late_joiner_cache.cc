@@ -0,0 +1,83 @@
+#include <stps/publisher/late_joiner_cache.h>
+
+#include <algorithm>
+
+namespace stps
+{
+
+namespace
+{
+    constexpr size_t kNoIndex = static_cast<size_t>(-1);
+}
+
+LateJoinerCache::LateJoinerCache()
+    : is_enabled_(false)
+    , last_sequence_(kNotCached)
+    , unkeyed_index_(kNoIndex)
+{
+}
+
+void LateJoinerCache::setPolicy(const LateJoinerCachePolicy& policy)
+{
+    std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+    policy_ = policy;
+    policy_.max_messages = std::max(policy.max_messages, size_t(1));
+    cached_buffers_.clear();
+    key_indices_.clear();
+    unkeyed_index_ = kNoIndex;
+    is_enabled_ = (policy_.mode != LateJoinerCacheMode::Disabled);
+}
+
+bool LateJoinerCache::isEnabled() const
+{
+    return is_enabled_;
+}
+
+uint64_t LateJoinerCache::add(const std::shared_ptr<Buffer>& buffer, bool keyed, uint64_t key)
+{
+    std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+
+    if (policy_.mode == LateJoinerCacheMode::Disabled)
+        return kNotCached;
+
+    if (policy_.mode == LateJoinerCacheMode::LastMessages)
+    {
+        cached_buffers_.push_back(buffer);
+        while (cached_buffers_.size() > policy_.max_messages)
+        {
+            cached_buffers_.pop_front();
+        }
+    }
+    else if (policy_.mode == LateJoinerCacheMode::LastValuePerKey)
+    {
+        size_t* index = &unkeyed_index_;
+        if (keyed)
+        {
+            index = &key_indices_.emplace(key, kNoIndex).first->second;
+        }
+
+        if (*index == kNoIndex)
+        {
+            *index = cached_buffers_.size();
+            cached_buffers_.push_back(buffer);
+        }
+        else
+        {
+            cached_buffers_[*index] = buffer;
+        }
+    }
+
+    // Never reset, so sequences stay comparable across policy changes
+    return ++last_sequence_;
+}
+
+LateJoinerCache::Snapshot LateJoinerCache::getSnapshot() const
+{
+    Snapshot snapshot;
+    std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+    snapshot.buffers.assign(cached_buffers_.begin(), cached_buffers_.end());
+    snapshot.last_sequence = last_sequence_;
+    return snapshot;
+}
+
+} // namespace stps
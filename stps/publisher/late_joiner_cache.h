@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stps/buffer.h>
+#include <stps/publisher/late_joiner_cache_policy.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace stps
+{
+
+// Keeps already framed (pooled) buffers of a publisher for replaying them to
+// new subscribers. Shared by the publisher, which adds every buffer it sends,
+// and its sessions, which take a snapshot when handshaking.
+class LateJoinerCache
+{
+    public:
+        // Sequence of buffers that have not been added to the cache
+        static constexpr uint64_t kNotCached = 0;
+
+        struct Snapshot
+        {
+            std::vector<std::shared_ptr<Buffer>> buffers;
+
+            // Every buffer added up to this sequence is either part of the
+            // snapshot or superseded by a buffer that is
+            uint64_t last_sequence = kNotCached;
+        };
+
+        LateJoinerCache();
+
+        LateJoinerCache(const LateJoinerCache&) = delete;
+
+        LateJoinerCache& operator=(const LateJoinerCache&) = delete;
+
+        // Drops all cached buffers
+        void setPolicy(const LateJoinerCachePolicy& policy);
+
+        bool isEnabled() const;
+
+        // Returns the sequence of the buffer, or kNotCached if disabled
+        uint64_t add(const std::shared_ptr<Buffer>& buffer, bool keyed, uint64_t key);
+
+        // Cached buffers, oldest first
+        Snapshot getSnapshot() const;
+
+    private:
+        std::atomic<bool> is_enabled_;
+
+        mutable std::mutex cache_mutex_;
+        LateJoinerCachePolicy policy_;
+        uint64_t last_sequence_;
+        std::deque<std::shared_ptr<Buffer>> cached_buffers_;
+
+        // LastValuePerKey: index in cached_buffers_ per key. Buffers are
+        // replaced in place, so the indices never change.
+        std::unordered_map<uint64_t, size_t> key_indices_;
+        size_t unkeyed_index_;
+};
+
+} // namespace stps
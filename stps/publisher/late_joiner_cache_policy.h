@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace stps
+{
+
+enum class LateJoinerCacheMode : uint8_t
+{
+	Disabled = 0,
+
+	// The last max_messages messages (a sendBatch() counts as one)
+	LastMessages = 1,
+
+	// The last message of every key (see Publisher::send(key, ...)). Messages
+	// sent without a key share one key.
+	LastValuePerKey = 2
+};
+
+// Messages retained by the publisher and sent to every new subscriber right
+// after the protocol handshake, before any newer message
+struct LateJoinerCachePolicy
+{
+	LateJoinerCacheMode mode = LateJoinerCacheMode::Disabled;
+	size_t max_messages = 1;
+};
+
+} // namespace stps
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace stps
+{
+
+// Every subscriber session keeps a send queue per priority. Between two writes
+// the oldest message of the highest priority queue is sent next. A write in
+// progress is never interrupted, so a large frame still delays everything
+// behind it until it has been written.
+enum class MessagePriority : uint8_t
+{
+	High = 0,
+	Normal = 1,
+	Low = 2
+};
+
+constexpr size_t kMessagePriorityCount = 3;
+
+} // namespace stps
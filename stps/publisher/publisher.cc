@@ -36,14 +36,90 @@ bool Publisher::isRunning() const
     return publisher_impl_->isRunning();
 }
 
-bool Publisher::send(const char* const data, size_t size) const
+bool Publisher::send(const char* const data, size_t size, MessagePriority priority) const
 {
-    return this->send({{data, size}});
+    const std::pair<const char* const, const size_t> payload(data, size);
+    return publisher_impl_->send(&payload, 1, priority);
 }
 
-bool Publisher::send(const std::vector<std::pair<const char* const, const size_t>>& payloads) const
+bool Publisher::send(const std::vector<std::pair<const char* const, const size_t>>& payloads,
+        MessagePriority priority) const
 {
-    return publisher_impl_->send(payloads);
+    return publisher_impl_->send(payloads.data(), payloads.size(), priority);
+}
+
+bool Publisher::send(uint64_t key, const char* const data, size_t size, MessagePriority priority) const
+{
+    const std::pair<const char* const, const size_t> payload(data, size);
+    return publisher_impl_->send(key, &payload, 1, priority);
+}
+
+bool Publisher::send(uint64_t key, const std::vector<std::pair<const char* const, const size_t>>& payloads,
+        MessagePriority priority) const
+{
+    return publisher_impl_->send(key, payloads.data(), payloads.size(), priority);
+}
+
+#ifdef STPS_HAS_COROUTINES
+boost::asio::awaitable<bool> Publisher::sendAsync(const char* const data, size_t size, 
+        MessagePriority priority) const
+{
+    co_return send(data, size, priority);
+}
+
+boost::asio::awaitable<bool> Publisher::sendAsync(uint64_t key, const char* const data, size_t size,
+        MessagePriority priority) const
+{
+    co_return send(key, data, size, priority);
+}
+#endif
+
+bool Publisher::sendBatch(const std::pair<const char* const, const size_t>* messages, size_t message_count,
+        MessagePriority priority) const
+{
+    return publisher_impl_->sendBatch(messages, message_count, priority);
+}
+
+bool Publisher::sendBatch(const std::vector<std::pair<const char* const, const size_t>>& messages,
+        MessagePriority priority) const
+{
+    return publisher_impl_->sendBatch(messages.data(), messages.size(), priority);
+}
+
+void Publisher::setZeroCopyThreshold(size_t threshold)
+{
+    publisher_impl_->setZeroCopyThreshold(threshold);
+}
+
+void Publisher::setSendQueueSize(size_t max_queued_messages)
+{
+    publisher_impl_->setSendQueueSize(max_queued_messages);
+}
+
+void Publisher::setConflationMode(ConflationMode conflation_mode)
+{
+    publisher_impl_->setConflationMode(conflation_mode);
+}
+
+void Publisher::setLateJoinerCache(const LateJoinerCachePolicy& policy)
+{
+    publisher_impl_->setLateJoinerCache(policy);
+}
+
+void Publisher::setEgressLimiter(const std::shared_ptr<EgressLimiter>& egress_limiter)
+{
+    publisher_impl_->setEgressLimiter(egress_limiter);
+}
+
+void Publisher::setBufferArena(const std::shared_ptr<BufferArena>& buffer_arena)
+{
+    publisher_impl_->setBufferArena(buffer_arena);
+}
+
+void Publisher::setSlowSubscriberPolicy(const SlowSubscriberPolicy& policy,
+        const std::function<void(const SlowSubscriberEvent&)>& slow_subscriber_handler)
+{
+    publisher_impl_->setSlowSubscriberPolicy(policy, slow_subscriber_handler);
 }
 
 void Publisher::cancel()
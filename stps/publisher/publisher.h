@@ -1,12 +1,20 @@
 #pragma once
 
+#include <stps/coroutine.h>
 #include <stps/executor/executor.h>
+#include <stps/memory/buffer_arena.h>
+#include <stps/publisher/conflation_mode.h>
+#include <stps/publisher/egress_limiter.h>
+#include <stps/publisher/late_joiner_cache_policy.h>
+#include <stps/publisher/message_priority.h>
+#include <stps/publisher/slow_subscriber_policy.h>
 
 #include <stdint.h>
 
 #include <memory>
 #include <string>
 #include <chrono>
+#include <functional>
 #include <vector>
 
 namespace stps
@@ -29,8 +37,73 @@ class  Publisher
         uint16_t getPort() const;
         size_t getSubscriberCount() const;
         bool isRunning() const;
-        bool send(const char* const data, size_t size) const;
-        bool send(const std::vector<std::pair<const char* const, const size_t>>& payloads) const;
+
+        // Messages of a higher priority overtake queued messages of a lower
+        // priority (see MessagePriority)
+        bool send(const char* const data, size_t size, 
+                MessagePriority priority = MessagePriority::Normal) const;
+        bool send(const std::vector<std::pair<const char* const, const size_t>>& payloads,
+                MessagePriority priority = MessagePriority::Normal) const;
+
+        // Sends a message with a key for ConflationMode::Keyed, e.g. an
+        // instrument id. Without keyed conflation the key is ignored.
+        bool send(uint64_t key, const char* const data, size_t size,
+                MessagePriority priority = MessagePriority::Normal) const;
+        bool send(uint64_t key, const std::vector<std::pair<const char* const, const size_t>>& payloads,
+                MessagePriority priority = MessagePriority::Normal) const;
+
+        // Sends each of the messages as a message of its own. All frames are
+        // written into one pooled buffer that is handed to every subscriber at
+        // once, so the batch is sent (or dropped from the send queue) as a unit;
+        // dropped messages count each message. Striping and downsampling select
+        // from the messages of a batch, which copies the selected ones.
+        bool sendBatch(const std::pair<const char* const, const size_t>* messages, size_t message_count,
+                MessagePriority priority = MessagePriority::Normal) const;
+        bool sendBatch(const std::vector<std::pair<const char* const, const size_t>>& messages,
+                MessagePriority priority = MessagePriority::Normal) const;
+
+#ifdef STPS_HAS_COROUTINES
+        // Completes once the message is queued for every subscriber, which
+        // never waits, so the coroutine continues without a thread switch.
+        // The result is the one of send().
+        boost::asio::awaitable<bool> sendAsync(const char* const data, size_t size,
+                MessagePriority priority = MessagePriority::Normal) const;
+        boost::asio::awaitable<bool> sendAsync(uint64_t key, const char* const data, size_t size,
+                MessagePriority priority = MessagePriority::Normal) const;
+#endif
+
+        // Frames (header + payload) of at least threshold bytes are sent with
+        // MSG_ZEROCOPY to subscribers that connect afterwards. 0 disables it.
+        void setZeroCopyThreshold(size_t threshold);
+
+        // Number of messages that may wait per subscriber while a write is in
+        // progress. When full, the oldest waiting message is dropped. The
+        // default of 1 only keeps the latest message.
+        void setSendQueueSize(size_t max_queued_messages);
+
+        // Applies to all current and future subscribers. With
+        // ConflationMode::Keyed a slow subscriber gets the latest message per
+        // key instead of only the latest messages.
+        void setConflationMode(ConflationMode conflation_mode);
+
+        // Retains recent messages (also while nobody is subscribed) and sends
+        // them to every new subscriber right after the handshake. Changing the
+        // policy drops the retained messages.
+        void setLateJoinerCache(const LateJoinerCachePolicy& policy);
+
+        // Applies to all current and future subscribers. Pass the same limiter
+        // to several publishers to shape their egress together; nullptr
+        // removes the limit.
+        void setEgressLimiter(const std::shared_ptr<EgressLimiter>& egress_limiter);
+
+        // Frame buffers the pool allocates afterwards come from the arena,
+        // idle pooled buffers are released. nullptr goes back to the heap.
+        void setBufferArena(const std::shared_ptr<BufferArena>& buffer_arena);
+
+        // Applies to all current and future subscribers. The handler is called
+        // from an executor thread whenever the policy triggers.
+        void setSlowSubscriberPolicy(const SlowSubscriberPolicy& policy,
+                const std::function<void(const SlowSubscriberEvent&)>& slow_subscriber_handler = nullptr);
 
         void cancel();
 
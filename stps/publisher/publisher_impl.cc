@@ -1,6 +1,8 @@
 #include <stps/publisher/publisher_impl.h>
 #include <stps/tcp_header.h>
 #include <stps/executor/executor_impl.h>
+#include <stps/tracing/probes.h>
+#include <stps/tracing/tracing.h>
 #include <iostream>
 #include "endian.h"
 
@@ -11,7 +13,22 @@ PublisherImpl::PublisherImpl(const std::shared_ptr<Executor>& executor)
     : is_running_(false)
     , executor_(executor)
     , acceptor_(*executor_->executor_impl_->ioService())
+    , publisher_sessions_(std::make_shared<const PublisherSessionList>())
+    , zerocopy_threshold_(0)
+    , next_sequence_number_(1)
+    , late_joiner_cache_(std::make_shared<LateJoinerCache>())
+    , send_queue_size_(1)
+    , conflation_mode_(ConflationMode::None)
+    , buffer_arena_enabled_(false)
+    , buffer_pool_([this]()
+            {
+                STPS_PROBE1(publisher_pool_miss, this);
+                return BufferArena::createBuffer(std::atomic_load(&buffer_arena_));
+            })
 {
+    std::stringstream ss;
+    ss << "Publisher 0x" << std::hex << this;
+    buffer_memory_component_ = executor_->executor_impl_->createBufferMemoryComponent(ss.str());
 }
 
 PublisherImpl::~PublisherImpl()
@@ -101,34 +118,38 @@ void PublisherImpl::cancel()
 
     is_running_ = false;
 
-    std::vector<std::shared_ptr<PublisherSession>> publisher_sessions;
-    {
-        std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mtx_);
-        publisher_sessions = publisher_sessions_;
-    }
-
-    for (const auto& session : publisher_sessions)
+    // Canceling a session removes it from the list, so we iterate a snapshot
+    const auto publisher_sessions = getPublisherSessions();
+    for (const auto& session : *publisher_sessions)
     {
         session->cancel();
     }
 }
 
+std::shared_ptr<const PublisherImpl::PublisherSessionList> PublisherImpl::getPublisherSessions() const
+{
+    return std::atomic_load(&publisher_sessions_);
+}
+
 void PublisherImpl::acceptClient()
 {
     std::function<void(const std::shared_ptr<PublisherSession>&)> publisher_session_closed_handler =
         [me = shared_from_this()](const std::shared_ptr<PublisherSession>& session) -> void
         {
             std::lock_guard<std::mutex> publisher_sessions_lock(me->publisher_sessions_mtx_);
-            auto session_it = std::find(me->publisher_sessions_.begin(), 
-                    me->publisher_sessions_.end(), session);
-            if (session_it != me->publisher_sessions_.end())
+            auto publisher_sessions = std::make_shared<PublisherSessionList>(*me->publisher_sessions_);
+            auto session_it = std::find(publisher_sessions->begin(), 
+                    publisher_sessions->end(), session);
+            if (session_it != publisher_sessions->end())
             {
-                me->publisher_sessions_.erase(session_it);
+                publisher_sessions->erase(session_it);
+                std::atomic_store(&me->publisher_sessions_, 
+                        std::shared_ptr<const PublisherSessionList>(std::move(publisher_sessions)));
                 std::cout << "Publisher " << me->localEndpointToString()
                     << ": Successfully removed Session to subscriber "
                     << session->remoteEndpointToString() 
                     << ". Current subscriber count: " 
-                    << std::to_string(me->publisher_sessions_.size()) << "."
+                    << std::to_string(me->publisher_sessions_->size()) << "."
                     << std::endl;
             }
             else
@@ -140,10 +161,13 @@ void PublisherImpl::acceptClient()
         };
 
     auto session = std::make_shared<PublisherSession>(executor_->executor_impl_->ioService(), 
+            executor_->executor_impl_->handlerStatistics(),
             publisher_session_closed_handler);
     acceptor_.async_accept(session->getSocket(), 
             [session, me = shared_from_this()](system::error_code ec)
             {
+                me->executor_->executor_impl_->handlerStatistics()->count(HandlerSource::PublisherAccept);
+
                 if (ec)
                 {
                     std::cout << "Publisher " << me->localEndpointToString()
@@ -156,20 +180,52 @@ void PublisherImpl::acceptClient()
                     std::cout << "Publisher " << me->localEndpointToString()
                     << ": Subscriber " << session->remoteEndpointToString()
                     << " has connected." << std::endl;
+                    STPS_PROBE2(publisher_session_accept, session.get(), 
+                            session->remoteEndpointToString().c_str());
                 }
 
-                session->start();
+                session->setZeroCopyThreshold(me->zerocopy_threshold_);
 
                 {
                     std::lock_guard<std::mutex> publisher_sessions_lock_(me->publisher_sessions_mtx_);
-                    me->publisher_sessions_.push_back(session);
+                    session->setSendQueueSize(me->send_queue_size_);
+                    session->setConflationMode(me->conflation_mode_);
+                    session->setLateJoinerCache(me->late_joiner_cache_);
+                    session->setEgressLimiter(me->egress_limiter_impl_);
+                    session->setNextSequenceNumberHandler(
+                            [weak_me = std::weak_ptr<PublisherImpl>(me)]() -> uint64_t
+                            {
+                                auto me = weak_me.lock();
+                                return (me ? me->next_sequence_number_.load() : 0);
+                            });
+                    session->setSlowSubscriberPolicy(me->slow_subscriber_policy_, 
+                            me->slow_subscriber_handler_);
+                    session->start();
+
+                    auto publisher_sessions = std::make_shared<PublisherSessionList>(*me->publisher_sessions_);
+                    publisher_sessions->push_back(session);
+                    std::atomic_store(&me->publisher_sessions_, 
+                            std::shared_ptr<const PublisherSessionList>(std::move(publisher_sessions)));
                 }
 
                 me->acceptClient();
             });
 }
 
-bool PublisherImpl::send(const std::vector<std::pair<const char* const, const size_t>>& payloads)
+bool PublisherImpl::send(const std::pair<const char* const, const size_t>* payloads, size_t payload_count,
+        MessagePriority priority)
+{
+    return sendToSessions(payloads, payload_count, false, 0, priority);
+}
+
+bool PublisherImpl::send(uint64_t key, const std::pair<const char* const, const size_t>* payloads, 
+        size_t payload_count, MessagePriority priority)
+{
+    return sendToSessions(payloads, payload_count, true, key, priority);
+}
+
+bool PublisherImpl::sendToSessions(const std::pair<const char* const, const size_t>* payloads, 
+        size_t payload_count, bool keyed, uint64_t key, MessagePriority priority)
 {
     if (!is_running_)
     {
@@ -178,9 +234,16 @@ bool PublisherImpl::send(const std::vector<std::pair<const char* const, const si
         return false;
     }
 
+    // Sessions closed after taking the snapshot ignore the buffer. With the
+    // late joiner cache the buffer is cached first, even without subscribers,
+    // and the snapshot is taken afterwards: a session missing from it replays
+    // the buffer from the cache.
+    const bool cache_enabled = late_joiner_cache_->isEnabled();
+    std::shared_ptr<const PublisherSessionList> publisher_sessions;
+    if (!cache_enabled)
     {
-        std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mtx_);
-        if (publisher_sessions_.empty())
+        publisher_sessions = getPublisherSessions();
+        if (publisher_sessions->empty())
         {
             std::cout << "Publisher::send " << localEndpointToString()
                 << ": No connection to any subscriber. Skip sending data."
@@ -189,55 +252,244 @@ bool PublisherImpl::send(const std::vector<std::pair<const char* const, const si
         }
     }
 
-    std::shared_ptr<std::vector<char>> buffer = buffer_pool_.allocate();
-    
-    std::stringstream buffer_pointer_ss;
-    buffer_pointer_ss << "0x" << std::hex << buffer.get();
-    const std::string buffer_pointer_string = buffer_pointer_ss.str();
+    STPS_TRACE(PublisherSendBegin, nullptr, this, 0);
+
+    std::shared_ptr<Buffer> buffer = createFrame(payloads, payload_count);
+    if (!buffer) return false;
 
+    uint64_t cache_sequence = LateJoinerCache::kNotCached;
+    if (cache_enabled)
     {
-        size_t header_size = sizeof(TCPHeader);
-        size_t entire_payload_size = 0;
-        for (const auto& payload : payloads)
+        cache_sequence = late_joiner_cache_->add(buffer, keyed, key);
+        publisher_sessions = getPublisherSessions();
+    }
+
+    for (const auto& publisher_session : *publisher_sessions)
+    {
+        if (keyed)
+            publisher_session->sendKeyedDataBuffer(buffer, key, cache_sequence, priority);
+        else
+            publisher_session->sendDataBuffer(buffer, cache_sequence, priority);
+    }
+
+    STPS_TRACE(PublisherSendEnd, buffer.get(), this, buffer->size());
+
+    return true;
+}
+
+bool PublisherImpl::sendBatch(const std::pair<const char* const, const size_t>* messages, size_t message_count,
+        MessagePriority priority)
+{
+    if (!is_running_)
+    {
+        std::cout << "Publisher::sendBatch " << localEndpointToString() 
+            << ": Tried to send data to a non-running Publisher" << std::endl;
+        return false;
+    }
+
+    if (message_count == 0)
+        return true;
+
+    // Same order as in sendToSessions()
+    const bool cache_enabled = late_joiner_cache_->isEnabled();
+    std::shared_ptr<const PublisherSessionList> publisher_sessions;
+    if (!cache_enabled)
+    {
+        publisher_sessions = getPublisherSessions();
+        if (publisher_sessions->empty())
         {
-            entire_payload_size += payload.second;
+            std::cout << "Publisher::sendBatch " << localEndpointToString()
+                << ": No connection to any subscriber. Skip sending data."
+                << std::endl;
+            return true;
         }
+    }
 
-        const size_t compelete_size = header_size + entire_payload_size;
+    STPS_TRACE(PublisherSendBegin, nullptr, this, 0);
+
+    std::shared_ptr<Buffer> buffer = createBatchFrame(messages, message_count);
+    if (!buffer) return false;
+
+    uint64_t cache_sequence = LateJoinerCache::kNotCached;
+    if (cache_enabled)
+    {
+        cache_sequence = late_joiner_cache_->add(buffer, false, 0);
+        publisher_sessions = getPublisherSessions();
+    }
+
+    for (const auto& publisher_session : *publisher_sessions)
+    {
+        publisher_session->sendDataBuffer(buffer, cache_sequence, priority);
+    }
+
+    STPS_TRACE(PublisherSendEnd, buffer.get(), this, buffer->size());
 
-        if (buffer->capacity() < compelete_size)
+    return true;
+}
+
+void PublisherImpl::setZeroCopyThreshold(size_t threshold)
+{
+    zerocopy_threshold_ = threshold;
+}
+
+void PublisherImpl::setSendQueueSize(size_t max_queued_messages)
+{
+    std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mtx_);
+    send_queue_size_ = max_queued_messages;
+    for (const auto& publisher_session : *publisher_sessions_)
+    {
+        publisher_session->setSendQueueSize(send_queue_size_);
+    }
+}
+
+void PublisherImpl::setConflationMode(ConflationMode conflation_mode)
+{
+    std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mtx_);
+    conflation_mode_ = conflation_mode;
+    for (const auto& publisher_session : *publisher_sessions_)
+    {
+        publisher_session->setConflationMode(conflation_mode_);
+    }
+}
+
+void PublisherImpl::setLateJoinerCache(const LateJoinerCachePolicy& policy)
+{
+    late_joiner_cache_->setPolicy(policy);
+}
+
+void PublisherImpl::setEgressLimiter(const std::shared_ptr<EgressLimiter>& egress_limiter)
+{
+    std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mtx_);
+    egress_limiter_ = egress_limiter;
+    egress_limiter_impl_ = (egress_limiter ? egress_limiter->egress_limiter_impl_ : nullptr);
+    for (const auto& publisher_session : *publisher_sessions_)
+    {
+        publisher_session->setEgressLimiter(egress_limiter_impl_);
+    }
+}
+
+void PublisherImpl::setBufferArena(const std::shared_ptr<BufferArena>& buffer_arena)
+{
+    std::atomic_store(&buffer_arena_, buffer_arena);
+    buffer_arena_enabled_ = bool(buffer_arena);
+    buffer_pool_.free_unused();
+}
+
+void PublisherImpl::setSlowSubscriberPolicy(const SlowSubscriberPolicy& policy,
+        const std::function<void(const SlowSubscriberEvent&)>& slow_subscriber_handler)
+{
+    std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mtx_);
+    slow_subscriber_policy_ = policy;
+    slow_subscriber_handler_ = slow_subscriber_handler;
+    for (const auto& publisher_session : *publisher_sessions_)
+    {
+        publisher_session->setSlowSubscriberPolicy(slow_subscriber_policy_, 
+                slow_subscriber_handler_);
+    }
+}
+
+std::shared_ptr<Buffer> PublisherImpl::allocateBuffer(size_t size)
+{
+    STPS_PROBE1(publisher_pool_allocate, this);
+
+    // With the executor's buffer memory, idle memory is kept there for all
+    // publishers and subscribers instead of in a pool of this publisher
+    const bool pooled = (!buffer_memory_component_ || buffer_arena_enabled_);
+    std::shared_ptr<Buffer> buffer = (pooled ? buffer_pool_.allocate() 
+            : BufferMemoryComponent::createBuffer(buffer_memory_component_));
+
+    try
+    {
+        if (pooled && (buffer->capacity() < size))
         {
-            buffer->reserve(static_cast<size_t>(compelete_size * 1.1));
+            buffer->reserve(static_cast<size_t>(size * 1.1));
         }
 
-        buffer->resize(compelete_size);
+        buffer->resize(size);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+
+    return buffer;
+}
+
+std::shared_ptr<Buffer> PublisherImpl::createFrame(
+        const std::pair<const char* const, const size_t>* payloads, size_t payload_count)
+{
+    std::shared_ptr<Buffer> buffer;
+    {
+        size_t header_size = sizeof(TCPHeader);
+        size_t entire_payload_size = 0;
+        for (size_t i = 0; i < payload_count; ++i)
+        {
+            entire_payload_size += payloads[i].second;
+        }
+
+        const size_t compelete_size = header_size + entire_payload_size;
+
+        buffer = allocateBuffer(compelete_size);
+        if (!buffer) return nullptr;
 
         auto header = reinterpret_cast<stps::TCPHeader*>(&(*buffer)[0]);
         header->header_size = htole16(sizeof(TCPHeader));
         header->type = MessageContentType::RegularPayload;
         header->reserved = 0;
         header->data_size = htole64(entire_payload_size);
+        header->sequence_number = htole64(next_sequence_number_.fetch_add(1, std::memory_order_relaxed));
 
         size_t current_position = header_size;
-        for (const auto& payload : payloads)
+        for (size_t i = 0; i < payload_count; ++i)
         {
-            if (payload.first && (payload.second > 0))
+            if (payloads[i].first && (payloads[i].second > 0))
             {
-                memcpy(&((*buffer)[current_position]), payload.first, payload.second);
-                current_position += payload.second;
+                memcpy(&((*buffer)[current_position]), payloads[i].first, payloads[i].second);
+                current_position += payloads[i].second;
             }
         }
     }
 
+    return buffer;
+}
+
+std::shared_ptr<Buffer> PublisherImpl::createBatchFrame(
+        const std::pair<const char* const, const size_t>* messages, size_t message_count)
+{
+    std::shared_ptr<Buffer> buffer;
+
     {
-        std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mtx_);
-        for (const auto& publisher_session : publisher_sessions_)
+        size_t compelete_size = message_count * sizeof(TCPHeader);
+        for (size_t i = 0; i < message_count; ++i)
+        {
+            compelete_size += messages[i].second;
+        }
+
+        buffer = allocateBuffer(compelete_size);
+        if (!buffer) return nullptr;
+
+        uint64_t sequence_number = next_sequence_number_.fetch_add(message_count, std::memory_order_relaxed);
+
+        size_t current_position = 0;
+        for (size_t i = 0; i < message_count; ++i)
         {
-            publisher_session->sendDataBuffer(buffer);
+            auto header = reinterpret_cast<stps::TCPHeader*>(&(*buffer)[current_position]);
+            header->header_size = htole16(sizeof(TCPHeader));
+            header->type = MessageContentType::RegularPayload;
+            header->reserved = 0;
+            header->data_size = htole64(messages[i].second);
+            header->sequence_number = htole64(sequence_number++);
+            current_position += sizeof(TCPHeader);
+
+            if (messages[i].first && (messages[i].second > 0))
+            {
+                memcpy(&((*buffer)[current_position]), messages[i].first, messages[i].second);
+            }
+            current_position += messages[i].second;
         }
     }
 
-    return true;
+    return buffer;
 }
 
 uint16_t PublisherImpl::getPort() const
@@ -259,8 +511,7 @@ uint16_t PublisherImpl::getPort() const
 
 size_t PublisherImpl::getSubscriberCount() const
 {
-    std::lock_guard<std::mutex> publisher_sessions_lock(publisher_sessions_mtx_);
-    return publisher_sessions_.size();
+    return getPublisherSessions()->size();
 }
 
 bool PublisherImpl::isRunning() const
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <stps/buffer.h>
 #include <stps/executor/executor.h>
+#include <stps/memory/buffer_arena.h>
+#include <stps/memory/buffer_memory.h>
+#include <stps/publisher/late_joiner_cache.h>
 #include <stps/publisher/publisher_session.h>
-#include <boost/asio.hpp>
+#include <stps/boost_asio.h>
 #include <recycle/shared_pool.hpp>
 
 #include <atomic>
@@ -34,7 +38,41 @@ class PublisherImpl : public std::enable_shared_from_this<PublisherImpl>
 
         void cancel();
 
-        bool send(const std::vector<std::pair<const char* const, const size_t>>& payloads);
+        // Payloads are passed as array + count, so sending a single payload
+        // does not need to build a vector
+        bool send(const std::pair<const char* const, const size_t>* payloads, size_t payload_count,
+                MessagePriority priority);
+
+        bool send(uint64_t key, const std::pair<const char* const, const size_t>* payloads, size_t payload_count,
+                MessagePriority priority);
+
+        bool sendBatch(const std::pair<const char* const, const size_t>* messages, size_t message_count,
+                MessagePriority priority);
+
+        // Copies the payloads behind a TCPHeader into a buffer from the pool.
+        // nullptr if the executor's buffer memory budget is exhausted.
+        std::shared_ptr<Buffer> createFrame(
+                const std::pair<const char* const, const size_t>* payloads, size_t payload_count);
+
+        // Writes one frame per message, back to back, into a single buffer from the pool.
+        // nullptr if the executor's buffer memory budget is exhausted.
+        std::shared_ptr<Buffer> createBatchFrame(
+                const std::pair<const char* const, const size_t>* messages, size_t message_count);
+
+        void setZeroCopyThreshold(size_t threshold);
+
+        void setSendQueueSize(size_t max_queued_messages);
+
+        void setConflationMode(ConflationMode conflation_mode);
+
+        void setLateJoinerCache(const LateJoinerCachePolicy& policy);
+
+        void setEgressLimiter(const std::shared_ptr<EgressLimiter>& egress_limiter);
+
+        void setSlowSubscriberPolicy(const SlowSubscriberPolicy& policy,
+                const std::function<void(const SlowSubscriberEvent&)>& slow_subscriber_handler);
+
+        void setBufferArena(const std::shared_ptr<BufferArena>& buffer_arena);
 
         uint16_t getPort() const;
         
@@ -46,8 +84,32 @@ class PublisherImpl : public std::enable_shared_from_this<PublisherImpl>
         std::atomic<bool> is_running_;
         const std::shared_ptr<Executor> executor_;
         asio::ip::tcp::acceptor acceptor_;
+
+        // Immutable snapshot of the sessions, read with std::atomic_load() and
+        // replaced with std::atomic_store(). Senders never take a lock; changes
+        // are serialized by publisher_sessions_mtx_.
+        using PublisherSessionList = std::vector<std::shared_ptr<PublisherSession>>;
         mutable std::mutex publisher_sessions_mtx_;
-        std::vector<std::shared_ptr<PublisherSession>> publisher_sessions_;
+        std::shared_ptr<const PublisherSessionList> publisher_sessions_;
+        std::atomic<size_t> zerocopy_threshold_;
+        std::atomic<uint64_t> next_sequence_number_;
+        const std::shared_ptr<LateJoinerCache> late_joiner_cache_;
+
+        // Protected by publisher_sessions_mtx_
+        size_t send_queue_size_;
+        ConflationMode conflation_mode_;
+        std::shared_ptr<EgressLimiter> egress_limiter_;
+        std::shared_ptr<EgressLimiterImpl> egress_limiter_impl_;
+        SlowSubscriberPolicy slow_subscriber_policy_;
+        std::function<void(const SlowSubscriberEvent&)> slow_subscriber_handler_;
+
+        // Backs the buffers of pool misses, read with std::atomic_load()
+        std::shared_ptr<BufferArena> buffer_arena_;
+        std::atomic<bool> buffer_arena_enabled_;
+
+        // The executor's buffer memory, replaces the buffer pool unless an
+        // arena is set. Only set in the constructor.
+        std::shared_ptr<BufferMemoryComponent> buffer_memory_component_;
 
         struct BufferPoolLockPolicy
         {
@@ -55,10 +117,19 @@ class PublisherImpl : public std::enable_shared_from_this<PublisherImpl>
             using lock_type = std::lock_guard<mutex_type>;
         };
 
-        recycle::shared_pool<std::vector<char>, BufferPoolLockPolicy> buffer_pool_;
+        recycle::shared_pool<Buffer, BufferPoolLockPolicy> buffer_pool_;
 
         void acceptClient();
 
+        // A buffer of the given size, nullptr if the buffer memory budget is
+        // exhausted
+        std::shared_ptr<Buffer> allocateBuffer(size_t size);
+
+        bool sendToSessions(const std::pair<const char* const, const size_t>* payloads, size_t payload_count,
+                bool keyed, uint64_t key, MessagePriority priority);
+
+        std::shared_ptr<const PublisherSessionList> getPublisherSessions() const;
+
         std::string toString(const asio::ip::tcp::endpoint& endpoint) const;
 
         std::string localEndpointToString() const;
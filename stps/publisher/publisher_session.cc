@@ -1,23 +1,76 @@
 #include <stps/publisher/publisher_session.h>
 #include <stps/tcp_header.h>
 #include <stps/protocol_handshake_message.h>
+#include <stps/tracing/probes.h>
+#include <stps/tracing/tracing.h>
 #include <thread>
 #include <endian.h>
 
 #include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <cerrno>
+#endif
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define STPS_HAS_ZEROCOPY 1
+#else
+#define STPS_HAS_ZEROCOPY 0
+#endif
 
 namespace stps
 {
 PublisherSession::PublisherSession(const std::shared_ptr<asio::io_service>& io_service,
+        const std::shared_ptr<HandlerStatistics>& handler_statistics,
         const std::function<void(const std::shared_ptr<PublisherSession>&)>& session_closed_handler)
     : io_service_(io_service)
+    , handler_statistics_(handler_statistics)
     , state_(State::NotStarted)
+    , protocol_version_(0)
     , session_closed_handler_(session_closed_handler)
     , data_socket_(*io_service_)
     , data_strand_(*io_service_)
     , sending_in_progress_(false)
+    , send_queues_{{SendQueue(&send_queue_memory_), SendQueue(&send_queue_memory_), SendQueue(&send_queue_memory_)}}
+    , max_buffers_to_send_(1)
+    , conflation_mode_(ConflationMode::None)
+    , replayed_cache_sequence_(LateJoinerCache::kNotCached)
+    , replay_position_(0)
+    , message_credit_limited_(false)
+    , byte_credit_limited_(false)
+    , message_credit_(0)
+    , byte_credit_(0)
+    , downsampling_every_nth_(0)
+    , downsampling_interval_(0)
+    , downsampling_counter_(0)
+    , last_downsampled_send_()
+    , downsampling_held_buffer_valid_(false)
+    , downsampling_held_buffer_{nullptr, 0, false, 0, 0, MessagePriority::Normal}
+    , downsampling_timer_(*io_service_)
+    , downsampling_timer_armed_(false)
+    , pending_bytes_(0)
+    , sending_buffer_size_(0)
+    , dropped_messages_(0)
+    , slow_subscriber_reported_(false)
+    , slow_subscriber_conflating_(false)
+    , slow_subscriber_timer_(*io_service_)
+    , slow_subscriber_timer_armed_(false)
+    , stripe_index_(0)
+    , stripe_count_(1)
+    , egress_limiter_waiting_(false)
+    , zerocopy_threshold_(0)
+    , zerocopy_next_send_id_(0)
+    , zerocopy_completion_wait_armed_(false)
+    , zerocopy_drain_timer_(*io_service_)
+    , zerocopy_drain_timer_armed_(false)
 {
-
+    static_assert(kMessagePriorityCount == 3, "One send queue per priority");
 }
 
 PublisherSession::~PublisherSession()
@@ -27,6 +80,15 @@ PublisherSession::~PublisherSession()
     std::string thread_id = ss.str();
     std::cout << "PublisherSession " << endpointToString() << ": Deleting from thread "
         << thread_id << "...\n";
+
+    // Only when the executor stopped before the zero-copy completions were
+    // drained. Reset the connection before the buffers return to the pool.
+    if (!zerocopy_pending_buffers_.empty())
+    {
+        system::error_code ec;
+        data_socket_.set_option(asio::socket_base::linger(true, 0), ec);
+        data_socket_.close(ec);
+    }
 }
 
 void PublisherSession::start()
@@ -39,6 +101,11 @@ void PublisherSession::start()
                 << ": Failed setting tcp::no_delay." << std::endl;
     }
 
+    if (zerocopy_threshold_ > 0)
+    {
+        enableZeroCopy();
+    }
+
     state_ = State::Handshaking;
 
     receiveTcpPacket();
@@ -55,11 +122,35 @@ void PublisherSession::sessionClosedHandler()
     if (previous_state == State::Canceled)
         return;
 
+    STPS_PROBE2(publisher_session_close, this, remoteEndpointToString().c_str());
+
+    if (zerocopy_threshold_ > 0)
+    {
+        // The zero-copy bookkeeping belongs to the strand
+        data_strand_.dispatch([me = shared_from_this()]()
+                {
+                    me->closeSocketAfterZeroCopyCompletions();
+                });
+    }
+    else
     {
         system::error_code ec;
         data_socket_.close(ec);
     }
 
+    {
+        std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+        system::error_code ec;
+        downsampling_timer_.cancel(ec);
+        slow_subscriber_timer_.cancel(ec);
+        downsampling_held_buffer_valid_ = false;
+        downsampling_held_buffer_.buffer.reset();
+        replay_buffers_.clear();
+        replay_position_ = 0;
+        if (egress_limiter_)
+            egress_limiter_->release(this);
+    }
+
     session_closed_handler_(shared_from_this());
 }
 
@@ -79,6 +170,7 @@ void PublisherSession::readHeaderLength()
             asio::transfer_at_least(sizeof(header->header_size)),
             data_strand_.wrap([me = shared_from_this(), header](system::error_code ec, std::size_t)
                 {
+                    me->handler_statistics_->count(HandlerSource::PublisherRead);
                     if (ec)
                     {
                         me->sessionClosedHandler();
@@ -114,6 +206,7 @@ void PublisherSession::readHeaderContent(const std::shared_ptr<TCPHeader>& heade
             data_strand_.wrap([me = shared_from_this(), header,
             bytes_to_discard_from_socket](system::error_code ec, std::size_t)
             {
+                me->handler_statistics_->count(HandlerSource::PublisherRead);
                 if (ec)
                 {
                     me->sessionClosedHandler();
@@ -144,6 +237,7 @@ void PublisherSession::discardDataBetweenHeaderAndPayload(const std::shared_ptr<
             asio::transfer_at_least(bytes_to_discard),
             data_strand_.wrap([me = shared_from_this(), header](system::error_code ec, std::size_t)
                 {
+                    me->handler_statistics_->count(HandlerSource::PublisherRead);
                     if (ec)
                     {
                         me->sessionClosedHandler();
@@ -164,8 +258,8 @@ void PublisherSession::readPayload(const std::shared_ptr<TCPHeader>& header)
         return;
     }
 
-    std::shared_ptr<std::vector<char>> data_buffer = 
-        std::make_shared<std::vector<char>>();
+    std::shared_ptr<Buffer> data_buffer = 
+        std::make_shared<Buffer>();
     data_buffer->resize(le64toh(header->data_size));
 
     asio::async_read(data_socket_,
@@ -174,20 +268,34 @@ void PublisherSession::readPayload(const std::shared_ptr<TCPHeader>& header)
             data_strand_.wrap([me = shared_from_this(), header,
                 data_buffer](system::error_code ec, std::size_t)
                 {
+                    me->handler_statistics_->count(HandlerSource::PublisherRead);
                     if (ec)
                     {
                         me->sessionClosedHandler();
                         return;
                     }
 
-                    if (header->type == MessageContentType::ProtocolHandshake)
+                    if ((header->type == MessageContentType::ProtocolHandshake)
+                            && (me->state_ == State::Handshaking))
                     {
                         ProtocolHandshakeMessage handshake_message;
                         size_t bytes_to_copy = std::min(data_buffer->size(),
                                 sizeof(ProtocolHandshakeMessage));
                         std::memcpy(&handshake_message, data_buffer->data(),
                                 bytes_to_copy);
-                        me->sendProtocolHandshakeResponse();
+                        me->sendProtocolHandshakeResponse(handshake_message);
+                        me->readHeaderLength();
+                    }
+                    else if ((header->type == MessageContentType::CreditGrant)
+                            && (me->protocol_version_ >= 2))
+                    {
+                        CreditGrantMessage credit_grant;
+                        size_t bytes_to_copy = std::min(data_buffer->size(),
+                                sizeof(CreditGrantMessage));
+                        std::memcpy(&credit_grant, data_buffer->data(),
+                                bytes_to_copy);
+                        me->addSendCredit(credit_grant);
+                        me->readHeaderLength();
                     }
                     else
                     {
@@ -196,11 +304,15 @@ void PublisherSession::readPayload(const std::shared_ptr<TCPHeader>& header)
                 }));
 }
 
-void PublisherSession::sendProtocolHandshakeResponse()
+void PublisherSession::sendProtocolHandshakeResponse(const ProtocolHandshakeMessage& handshake_request)
 {
     if (state_ == State::Canceled) return;
 
-    std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>();
+    // Frames are shared by all sessions and carry a sequence number.
+    // Subscribers of version 0 get them without it, see sendBufferToClient().
+    protocol_version_ = std::min(handshake_request.protocol_version, kProtocolVersion);
+
+    std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
     buffer->resize(sizeof(TCPHeader) + sizeof(ProtocolHandshakeMessage));
 
     TCPHeader* header = reinterpret_cast<TCPHeader*>(buffer->data());
@@ -208,43 +320,660 @@ void PublisherSession::sendProtocolHandshakeResponse()
     header->type = MessageContentType::ProtocolHandshake;
     header->reserved = 0;
     header->data_size = htole64(sizeof(ProtocolHandshakeMessage));
+    header->sequence_number = 0;
 
     ProtocolHandshakeMessage* handshake_message = 
         reinterpret_cast<ProtocolHandshakeMessage*>(&(buffer->operator[](sizeof(TCPHeader))));
-    handshake_message->protocol_version = 0;
+    handshake_message->protocol_version = protocol_version_;
+
+    STPS_PROBE2(publisher_handshake, this, handshake_message->protocol_version);
+
+    {
+        std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+
+        if (protocol_version_ >= 2)
+        {
+            const uint64_t window_messages = le64toh(handshake_request.credit_window_messages);
+            const uint64_t window_bytes = le64toh(handshake_request.credit_window_bytes);
+            message_credit_limited_ = (window_messages > 0);
+            byte_credit_limited_ = (window_bytes > 0);
+            message_credit_ = static_cast<int64_t>(std::min<uint64_t>(window_messages, kMaxSendCredit));
+            byte_credit_ = static_cast<int64_t>(std::min<uint64_t>(window_bytes, kMaxSendCredit));
+        }
+
+        if (protocol_version_ >= 3)
+        {
+            downsampling_every_nth_ = le64toh(handshake_request.downsampling_every_nth);
+            downsampling_interval_ = std::chrono::microseconds(static_cast<int64_t>(std::min<uint64_t>(
+                            le64toh(handshake_request.downsampling_interval_us), INT64_MAX / 1000)));
+        }
+
+        if (protocol_version_ >= 4)
+        {
+            stripe_count_ = std::max<uint32_t>(le32toh(handshake_request.stripe_count), 1);
+            stripe_index_ = le32toh(handshake_request.stripe_index) % stripe_count_;
+            if (next_sequence_number_handler_)
+                handshake_message->next_sequence_number = htole64(next_sequence_number_handler_());
+        }
+
+        // Late joiner cache replay. Queued buffers and buffers arriving later
+        // that the snapshot covers are not sent again. Striped connections
+        // start at the next sequence number and get no replay.
+        // The cached buffers are sent as they are, see bufferSentHandler().
+        if (late_joiner_cache_ && late_joiner_cache_->isEnabled() && (stripe_count_ <= 1))
+        {
+            LateJoinerCache::Snapshot replay = late_joiner_cache_->getSnapshot();
+            replay_buffers_ = std::move(replay.buffers);
+            replay_position_ = 0;
+            for (const auto& cached_buffer : replay_buffers_)
+                pending_bytes_ += cached_buffer->size();
+
+            replayed_cache_sequence_ = replay.last_sequence;
+            removeReplayedBuffers();
+        }
 
-    sendBufferToClient(buffer);
+        STPS_TRACE(PublisherEnqueue, buffer.get(), this, buffer->size());
+        sending_in_progress_ = true;
+        last_write_progress_ = std::chrono::steady_clock::now();
+        pending_bytes_ += buffer->size();
+        armSlowSubscriberTimer();
+        sendBufferToClient(buffer);
+    }
     State old_state = state_.exchange(State::Running);
     if (old_state != State::Handshaking) state_ = old_state;
 }
 
-void PublisherSession::sendDataBuffer(const std::shared_ptr<std::vector<char>>& buffer)
+void PublisherSession::sendDataBuffer(const std::shared_ptr<Buffer>& buffer, 
+        uint64_t cache_sequence, MessagePriority priority)
+{
+    enqueueDataBuffer(buffer, false, 0, cache_sequence, priority);
+}
+
+void PublisherSession::sendKeyedDataBuffer(const std::shared_ptr<Buffer>& buffer, uint64_t key,
+        uint64_t cache_sequence, MessagePriority priority)
+{
+    enqueueDataBuffer(buffer, true, key, cache_sequence, priority);
+}
+
+void PublisherSession::enqueueDataBuffer(const std::shared_ptr<Buffer>& buffer, 
+        bool keyed, uint64_t key, uint64_t cache_sequence, MessagePriority priority)
 {
     if (state_ == State::Canceled) return;
 
     {
         std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+        if (isReplayed(cache_sequence)) return;
+
+        // The messages of a batch are split across the stripes
+        QueuedBuffer queued_buffer{buffer, 0, keyed, key, cache_sequence, priority};
+        if (stripe_count_ > 1)
+        {
+            queued_buffer.buffer = selectFrames(buffer, [this](const TCPHeader& header)
+                    {
+                        return isOwnStripe(le64toh(header.sequence_number));
+                    });
+            if (!queued_buffer.buffer) return;
+        }
+        queued_buffer.message_count = countFrames(*queued_buffer.buffer, 0);
+
+        if (passDownsampling(queued_buffer))
+            queueDataBuffer(queued_buffer);
+    }
+}
+
+bool PublisherSession::passDownsampling(QueuedBuffer& queued_buffer)
+{
+    if (downsampling_every_nth_ > 1)
+    {
+        queued_buffer.buffer = selectFrames(queued_buffer.buffer, [this](const TCPHeader&)
+                {
+                    return (downsampling_counter_++ % downsampling_every_nth_) == 0;
+                });
+        if (!queued_buffer.buffer) return false;
+        queued_buffer.message_count = countFrames(*queued_buffer.buffer, 0);
+    }
+
+    if (downsampling_interval_.count() <= 0) 
+        return true;
+
+    // At most one message per interval, the newest of a batch
+    if (queued_buffer.message_count > 1)
+    {
+        uint64_t frame_index = 0;
+        queued_buffer.buffer = selectFrames(queued_buffer.buffer, 
+                [&frame_index, frame_count = queued_buffer.message_count](const TCPHeader&)
+                {
+                    return ++frame_index == frame_count;
+                });
+        queued_buffer.message_count = 1;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (!downsampling_timer_armed_ && (now - last_downsampled_send_ >= downsampling_interval_))
+    {
+        last_downsampled_send_ = now;
+        return true;
+    }
+
+    // Too early. Only the newest buffer of the interval is sent, once the
+    // interval has passed.
+    downsampling_held_buffer_ = queued_buffer;
+    downsampling_held_buffer_valid_ = true;
+
+    if (!downsampling_timer_armed_ && (state_ != State::Canceled))
+    {
+        downsampling_timer_armed_ = true;
+        downsampling_timer_.expires_at(last_downsampled_send_ + downsampling_interval_);
+        downsampling_timer_.async_wait(data_strand_.wrap([me = shared_from_this()](system::error_code ec)
+                    {
+                        me->handler_statistics_->count(HandlerSource::Timer);
+                        if (ec) return;
+                        me->sendHeldDownsampledBuffer();
+                    }));
+    }
+    return false;
+}
+
+void PublisherSession::sendHeldDownsampledBuffer()
+{
+    if (state_ == State::Canceled) return;
+
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+    downsampling_timer_armed_ = false;
+    if (!downsampling_held_buffer_valid_) return;
+
+    last_downsampled_send_ = std::chrono::steady_clock::now();
+    downsampling_held_buffer_valid_ = false;
+    const QueuedBuffer queued_buffer = downsampling_held_buffer_;
+    downsampling_held_buffer_.buffer.reset();
+    queueDataBuffer(queued_buffer);
+}
+
+bool PublisherSession::isOwnStripe(uint64_t sequence_number) const
+{
+    return (stripe_count_ <= 1) || ((sequence_number % stripe_count_) == stripe_index_);
+}
+
+template <typename KeepFrame>
+std::shared_ptr<Buffer> PublisherSession::selectFrames(const std::shared_ptr<Buffer>& buffer, 
+        KeepFrame keep_frame)
+{
+    // Offset and size of the kept frames
+    std::vector<std::pair<size_t, size_t>> kept_frames;
+    size_t kept_size = 0;
+    bool all_kept = true;
+
+    size_t offset = 0;
+    while (offset + sizeof(TCPHeader) <= buffer->size())
+    {
+        const TCPHeader* header = reinterpret_cast<const TCPHeader*>(buffer->data() + offset);
+        const size_t frame_size = le16toh(header->header_size) + le64toh(header->data_size);
+
+        // A single frame is kept or dropped as it is
+        if ((offset == 0) && (frame_size >= buffer->size()))
+            return (keep_frame(*header) ? buffer : nullptr);
+
+        if (keep_frame(*header))
+        {
+            kept_frames.emplace_back(offset, frame_size);
+            kept_size += frame_size;
+        }
+        else
+        {
+            all_kept = false;
+        }
+        offset += frame_size;
+    }
 
-        if ((state_ == State::Running) && !sending_in_progress_)
+    if (all_kept) return buffer;
+    if (kept_frames.empty()) return nullptr;
+
+    std::shared_ptr<Buffer> selected_buffer = std::make_shared<Buffer>();
+    selected_buffer->resize(kept_size);
+    size_t current_position = 0;
+    for (const auto& kept_frame : kept_frames)
+    {
+        std::memcpy(selected_buffer->data() + current_position, buffer->data() + kept_frame.first, 
+                kept_frame.second);
+        current_position += kept_frame.second;
+    }
+    return selected_buffer;
+}
+
+bool PublisherSession::isReplayed(uint64_t cache_sequence) const
+{
+    // Already sent (or superseded) by the late joiner cache replay
+    return (cache_sequence != LateJoinerCache::kNotCached) 
+        && (cache_sequence <= replayed_cache_sequence_);
+}
+
+void PublisherSession::queueDataBuffer(const QueuedBuffer& queued_buffer)
+{
+    const std::shared_ptr<Buffer>& buffer = queued_buffer.buffer;
+
+    if (isReplayed(queued_buffer.cache_sequence))
+        return;
+
+    STPS_TRACE(PublisherEnqueue, buffer.get(), this, buffer->size());
+
+    pending_bytes_ += buffer->size();
+
+    if ((state_ == State::Running) && !sending_in_progress_ && hasSendCredit())
+    {
+        sending_in_progress_ = true;
+        last_write_progress_ = std::chrono::steady_clock::now();
+        armSlowSubscriberTimer();
+        consumeSendCredit(*buffer, 0);
+        sendBufferToClient(buffer);
+    }
+    else
+    {
+        SendQueue& send_queue = send_queues_[static_cast<size_t>(queued_buffer.priority)];
+        if (isKeyedConflation())
         {
-            sending_in_progress_ = true;
-            sendBufferToClient(buffer);
+            if (!replaceQueuedBuffer(send_queue, queued_buffer))
+            {
+                const uint64_t position = send_queue.front_position + send_queue.buffers.size();
+                send_queue.buffers.push_back(queued_buffer);
+                if (queued_buffer.keyed)
+                    send_queue.key_positions[queued_buffer.key] = position;
+                else
+                    send_queue.unkeyed_position = position;
+            }
         }
         else
         {
-            next_buffer_to_send_ = buffer;
+            send_queue.buffers.push_back(queued_buffer);
+            trimSendQueue();
         }
     }
+
+    checkSlowSubscriber();
+}
+
+bool PublisherSession::replaceQueuedBuffer(SendQueue& send_queue, const QueuedBuffer& new_queued_buffer)
+{
+    uint64_t position = kNotQueued;
+    if (new_queued_buffer.keyed)
+    {
+        auto key_position_it = send_queue.key_positions.find(new_queued_buffer.key);
+        if (key_position_it != send_queue.key_positions.end())
+            position = key_position_it->second;
+    }
+    else
+    {
+        position = send_queue.unkeyed_position;
+    }
+
+    if (position == kNotQueued) return false;
+
+    QueuedBuffer& queued_buffer = send_queue.buffers[position - send_queue.front_position];
+    const size_t dropped_size = queued_buffer.buffer->size();
+    STPS_TRACE(PublisherDrop, queued_buffer.buffer.get(), this, dropped_size);
+    pending_bytes_ -= dropped_size;
+    dropped_messages_ += queued_buffer.message_count;
+    STPS_PROBE3(publisher_drop, this, dropped_size, dropped_messages_);
+
+    queued_buffer.buffer = new_queued_buffer.buffer;
+    queued_buffer.message_count = new_queued_buffer.message_count;
+    return true;
+}
+
+void PublisherSession::rebuildQueuedKeyPositions(SendQueue& send_queue)
+{
+    send_queue.key_positions.clear();
+    send_queue.unkeyed_position = kNotQueued;
+
+    if (!isKeyedConflation()) return;
+
+    // Buffers queued before switching to keyed conflation may share a key.
+    // The newest one is the one that gets replaced.
+    for (size_t i = 0; i < send_queue.buffers.size(); ++i)
+    {
+        const uint64_t position = send_queue.front_position + i;
+        if (send_queue.buffers[i].keyed)
+            send_queue.key_positions[send_queue.buffers[i].key] = position;
+        else
+            send_queue.unkeyed_position = position;
+    }
+}
+
+PublisherSession::SendQueue* PublisherSession::nextSendQueue()
+{
+    for (auto& send_queue : send_queues_)
+    {
+        if (!send_queue.buffers.empty())
+            return &send_queue;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Buffer> PublisherSession::popSendQueueFront(SendQueue& send_queue)
+{
+    QueuedBuffer& front = send_queue.buffers.front();
+    if (isKeyedConflation())
+    {
+        if (front.keyed)
+        {
+            auto key_position_it = send_queue.key_positions.find(front.key);
+            if ((key_position_it != send_queue.key_positions.end())
+                    && (key_position_it->second == send_queue.front_position))
+            {
+                send_queue.key_positions.erase(key_position_it);
+            }
+        }
+        else if (send_queue.unkeyed_position == send_queue.front_position)
+        {
+            send_queue.unkeyed_position = kNotQueued;
+        }
+    }
+
+    std::shared_ptr<Buffer> buffer = std::move(front.buffer);
+    send_queue.buffers.pop_front();
+    send_queue.front_position++;
+    return buffer;
+}
+
+void PublisherSession::removeReplayedBuffers()
+{
+    for (auto& send_queue : send_queues_)
+    {
+        auto queued_buffer_it = send_queue.buffers.begin();
+        while (queued_buffer_it != send_queue.buffers.end())
+        {
+            if (isReplayed(queued_buffer_it->cache_sequence))
+            {
+                pending_bytes_ -= queued_buffer_it->buffer->size();
+                queued_buffer_it = send_queue.buffers.erase(queued_buffer_it);
+            }
+            else
+            {
+                ++queued_buffer_it;
+            }
+        }
+
+        rebuildQueuedKeyPositions(send_queue);
+    }
+}
+
+void PublisherSession::setLateJoinerCache(const std::shared_ptr<LateJoinerCache>& late_joiner_cache)
+{
+    late_joiner_cache_ = late_joiner_cache;
+}
+
+void PublisherSession::setNextSequenceNumberHandler(const std::function<uint64_t()>& next_sequence_number_handler)
+{
+    next_sequence_number_handler_ = next_sequence_number_handler;
+}
+
+void PublisherSession::setSendQueueSize(size_t max_queued_buffers)
+{
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+    max_buffers_to_send_ = std::max(max_queued_buffers, size_t(1));
+    trimSendQueue();
+}
+
+void PublisherSession::setConflationMode(ConflationMode conflation_mode)
+{
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+    conflation_mode_ = conflation_mode;
+    for (auto& send_queue : send_queues_)
+        rebuildQueuedKeyPositions(send_queue);
+    trimSendQueue();
+}
+
+void PublisherSession::setEgressLimiter(const std::shared_ptr<EgressLimiterImpl>& egress_limiter)
+{
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+    if (egress_limiter_ && (egress_limiter_ != egress_limiter))
+        egress_limiter_->release(this);
+    egress_limiter_ = egress_limiter;
+}
+
+void PublisherSession::setSlowSubscriberPolicy(const SlowSubscriberPolicy& policy,
+        const std::function<void(const SlowSubscriberEvent&)>& slow_subscriber_handler)
+{
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+    slow_subscriber_policy_ = policy;
+    slow_subscriber_handler_ = slow_subscriber_handler;
+    resetSlowSubscriber();
+}
+
+void PublisherSession::trimSendQueue()
+{
+    // With keyed conflation the queue is bounded by the number of keys
+    if (isKeyedConflation()) return;
+
+    for (auto& send_queue : send_queues_)
+    {
+        while (send_queue.buffers.size() > maxQueuedBuffers())
+        {
+            const size_t dropped_size = send_queue.buffers.front().buffer->size();
+            const uint64_t dropped_message_count = send_queue.buffers.front().message_count;
+            STPS_TRACE(PublisherDrop, send_queue.buffers.front().buffer.get(), this, dropped_size);
+            pending_bytes_ -= dropped_size;
+            popSendQueueFront(send_queue);
+            dropped_messages_ += dropped_message_count;
+            STPS_PROBE3(publisher_drop, this, dropped_size, dropped_messages_);
+        }
+    }
+}
+
+bool PublisherSession::isKeyedConflation() const
+{
+    return (conflation_mode_ == ConflationMode::Keyed) && !slow_subscriber_conflating_;
+}
+
+size_t PublisherSession::maxQueuedBuffers() const
+{
+    return (slow_subscriber_conflating_ ? 1 : max_buffers_to_send_);
+}
+
+bool PublisherSession::exceedsSlowSubscriberPolicy(std::chrono::milliseconds write_lag, 
+        size_t pending_bytes) const
+{
+    const bool lag_exceeded = (slow_subscriber_policy_.max_write_lag.count() > 0)
+        && (write_lag > slow_subscriber_policy_.max_write_lag);
+    const bool pending_bytes_exceeded = (slow_subscriber_policy_.max_pending_bytes > 0)
+        && (pending_bytes > slow_subscriber_policy_.max_pending_bytes);
+    return lag_exceeded || pending_bytes_exceeded;
+}
+
+void PublisherSession::checkSlowSubscriber()
+{
+    if (slow_subscriber_reported_ || !sending_in_progress_ || egress_limiter_waiting_) return;
+
+    const auto write_lag = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - last_write_progress_);
+
+    if (!exceedsSlowSubscriberPolicy(write_lag, pending_bytes_)) return;
+
+    slow_subscriber_reported_ = true;
+
+    if (slow_subscriber_policy_.action == SlowSubscriberAction::Conflate)
+    {
+        slow_subscriber_conflating_ = true;
+        for (auto& send_queue : send_queues_)
+            rebuildQueuedKeyPositions(send_queue);
+        trimSendQueue();
+    }
+
+    SlowSubscriberEvent event;
+    event.subscriber_endpoint = remoteEndpointToString();
+    event.write_lag = write_lag;
+    event.pending_bytes = pending_bytes_;
+    event.dropped_messages = dropped_messages_;
+    event.action = slow_subscriber_policy_.action;
+
+    // We are called from the sending thread, possibly while the publisher holds
+    // its session lock. Notifying and disconnecting is done from the strand.
+    data_strand_.post([me = shared_from_this(), event, handler = slow_subscriber_handler_]()
+            {
+                std::cout << "PublisherSession " << me->endpointToString() 
+                    << ": Slow subscriber detected. Write lag: " << event.write_lag.count()
+                    << " ms, pending bytes: " << event.pending_bytes 
+                    << ", dropped messages: " << event.dropped_messages << std::endl;
+
+                if (handler)
+                {
+                    handler(event);
+                }
+
+                if (event.action == SlowSubscriberAction::Disconnect)
+                {
+                    me->sessionClosedHandler();
+                }
+            });
 }
 
-void PublisherSession::sendBufferToClient(const std::shared_ptr<std::vector<char>>& buffer)
+void PublisherSession::armSlowSubscriberTimer()
+{
+    if (slow_subscriber_timer_armed_ || slow_subscriber_reported_ || !sending_in_progress_
+            || egress_limiter_waiting_ || (slow_subscriber_policy_.max_write_lag.count() <= 0) || (state_ == State::Canceled))
+        return;
+
+    // Fires once the current write has taken longer than allowed. A write
+    // completing in between moves the deadline when the timer is re-armed.
+    slow_subscriber_timer_armed_ = true;
+    slow_subscriber_timer_.expires_at(last_write_progress_ + slow_subscriber_policy_.max_write_lag 
+            + std::chrono::milliseconds(1));
+    slow_subscriber_timer_.async_wait(data_strand_.wrap([me = shared_from_this()](system::error_code ec)
+                {
+                    me->handler_statistics_->count(HandlerSource::Timer);
+                    std::lock_guard<std::mutex> next_buffer_lock(me->next_buffer_mutex_);
+                    me->slow_subscriber_timer_armed_ = false;
+                    if (ec) return;
+                    me->checkSlowSubscriber();
+                    me->armSlowSubscriberTimer();
+                }));
+}
+
+void PublisherSession::resetSlowSubscriber()
+{
+    slow_subscriber_reported_ = false;
+
+    if (slow_subscriber_conflating_)
+    {
+        slow_subscriber_conflating_ = false;
+        for (auto& send_queue : send_queues_)
+            rebuildQueuedKeyPositions(send_queue);
+    }
+
+    armSlowSubscriberTimer();
+}
+
+void PublisherSession::setZeroCopyThreshold(size_t threshold)
+{
+    zerocopy_threshold_ = threshold;
+}
+
+void PublisherSession::sendBufferToClient(const std::shared_ptr<Buffer>& buffer)
+{
+    if (state_ == State::Canceled) return;
+
+    sending_buffer_size_ = buffer->size();
+
+    // Subscribers of version 0 do not skip header content they don't know
+    const std::shared_ptr<Buffer> wire_buffer = (protocol_version_ < 1 ? createVersion0Frames(*buffer) : buffer);
+
+    if (egress_limiter_ 
+            && !egress_limiter_->acquire(this, wire_buffer->size(), data_strand_.wrap([me = shared_from_this(), wire_buffer]()
+                    {
+                        {
+                            // The write starts now, the wait for tokens was shaping
+                            std::lock_guard<std::mutex> next_buffer_lock(me->next_buffer_mutex_);
+                            me->egress_limiter_waiting_ = false;
+                            me->last_write_progress_ = std::chrono::steady_clock::now();
+                            me->armSlowSubscriberTimer();
+                        }
+                        me->writeBufferToClient(wire_buffer);
+                    })))
+    {
+        egress_limiter_waiting_ = true;
+        return;
+    }
+
+    writeBufferToClient(wire_buffer);
+}
+
+std::shared_ptr<Buffer> PublisherSession::createVersion0Frames(const Buffer& buffer)
+{
+    // The header up to the sequence number
+    constexpr uint16_t version0_header_size = offsetof(TCPHeader, sequence_number);
+
+    const uint64_t frame_count = countFrames(buffer, 0);
+    std::shared_ptr<Buffer> version0_buffer = std::make_shared<Buffer>();
+    version0_buffer->resize(buffer.size() - frame_count * (sizeof(TCPHeader) - version0_header_size));
+
+    size_t offset = 0;
+    size_t current_position = 0;
+    while (offset + sizeof(TCPHeader) <= buffer.size())
+    {
+        const TCPHeader* header = reinterpret_cast<const TCPHeader*>(buffer.data() + offset);
+        const uint16_t header_size = le16toh(header->header_size);
+        const size_t data_size = static_cast<size_t>(le64toh(header->data_size));
+
+        std::memcpy(version0_buffer->data() + current_position, header, version0_header_size);
+        reinterpret_cast<TCPHeader*>(version0_buffer->data() + current_position)->header_size 
+            = htole16(version0_header_size);
+        current_position += version0_header_size;
+
+        std::memcpy(version0_buffer->data() + current_position, buffer.data() + offset + header_size, data_size);
+        current_position += data_size;
+        offset += header_size + data_size;
+    }
+
+    return version0_buffer;
+}
+
+void PublisherSession::writeBufferToClient(const std::shared_ptr<Buffer>& buffer)
+{
+    if (state_ == State::Canceled) return;
+
+    STPS_TRACE(PublisherWriteStart, buffer.get(), this, buffer->size());
+
+    if ((zerocopy_threshold_ > 0) && (buffer->size() >= zerocopy_threshold_))
+    {
+        sendBufferToClientZeroCopy(buffer, 0);
+    }
+    else
+    {
+        sendBufferToClientCopying(buffer, 0);
+    }
+}
+
+void PublisherSession::sendBufferToClientCopying(const std::shared_ptr<Buffer>& buffer, 
+        size_t offset)
 {
     if (state_ == State::Canceled) return;
 
     asio::async_write(data_socket_,
-            asio::buffer(*buffer),
-            data_strand_.wrap([me = shared_from_this(), buffer](system::error_code ec, std::size_t)
+            asio::buffer(buffer->data() + offset, buffer->size() - offset),
+            data_strand_.wrap(withHandlerMemory(write_handler_memory_, [me = shared_from_this(), buffer](system::error_code ec, std::size_t)
+                {
+                    me->handler_statistics_->count(HandlerSource::PublisherWrite);
+                    if (ec)
+                    {
+                        me->sessionClosedHandler();
+                        return;
+                    }
+
+                    me->bufferSentHandler(buffer);
+                }
+                
+                )));
+}
+
+void PublisherSession::sendBufferToClientZeroCopy(const std::shared_ptr<Buffer>& buffer, 
+        size_t offset)
+{
+#if STPS_HAS_ZEROCOPY
+    if (state_ == State::Canceled) return;
+
+    data_socket_.async_wait(asio::ip::tcp::socket::wait_write,
+            data_strand_.wrap(withHandlerMemory(write_handler_memory_, [me = shared_from_this(), buffer, offset](system::error_code ec)
                 {
+                    me->handler_statistics_->count(HandlerSource::PublisherWrite);
                     if (ec)
                     {
                         me->sessionClosedHandler();
@@ -256,22 +985,307 @@ void PublisherSession::sendBufferToClient(const std::shared_ptr<std::vector<char
                         return;
                     }
 
+                    size_t bytes_sent = offset;
+                    while (bytes_sent < buffer->size())
                     {
-                        std::lock_guard<std::mutex> next_buffer_lock(me->next_buffer_mutex_);
-                        if (me->next_buffer_to_send_)
-                        {
-                            auto next_buffer_tmp = me->next_buffer_to_send_;
-                            me->next_buffer_to_send_ = nullptr;
-                            me->sendBufferToClient(next_buffer_tmp);
-                        }
-                        else
+                        const ssize_t result = ::send(me->data_socket_.native_handle(), 
+                                buffer->data() + bytes_sent, buffer->size() - bytes_sent,
+                                MSG_ZEROCOPY | MSG_NOSIGNAL);
+                        if (result < 0)
                         {
-                            me->sending_in_progress_ = false;
+                            if (errno == EINTR)
+                            {
+                                continue;
+                            }
+                            else if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                            {
+                                me->sendBufferToClientZeroCopy(buffer, bytes_sent);
+                            }
+                            else if (errno == ENOBUFS)
+                            {
+                                // The socket's optmem budget for pinned pages is
+                                // exhausted. Send the rest the regular way.
+                                me->sendBufferToClientCopying(buffer, bytes_sent);
+                            }
+                            else
+                            {
+                                std::cout << "PublisherSession " << me->endpointToString()
+                                    << ": Zero-copy send failed: " << std::strerror(errno) << std::endl;
+                                me->sessionClosedHandler();
+                            }
+                            return;
                         }
+
+                        // Every successful MSG_ZEROCOPY send gets the next id of the
+                        // socket's notification counter. The buffer has to stay alive
+                        // until the kernel reports that id as completed.
+                        me->zerocopy_pending_buffers_.emplace_back(me->zerocopy_next_send_id_++, buffer);
+                        bytes_sent += static_cast<size_t>(result);
                     }
-                }
-                
-                ));
+
+                    me->reapZeroCopyCompletions();
+                    me->bufferSentHandler(buffer);
+                })));
+#else
+    sendBufferToClientCopying(buffer, offset);
+#endif
+}
+
+void PublisherSession::bufferSentHandler([[maybe_unused]] const std::shared_ptr<Buffer>& buffer)
+{
+    if (state_ == State::Canceled)
+    {
+        return;
+    }
+
+    STPS_TRACE(PublisherWriteComplete, buffer.get(), this, buffer->size());
+    STPS_PROBE2(publisher_frame_sent, this, buffer->size());
+
+    {
+        std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+        pending_bytes_ -= sending_buffer_size_;
+        const auto now = std::chrono::steady_clock::now();
+        const auto write_lag = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_write_progress_);
+        last_write_progress_ = now;
+
+        // Caught up once a write completes within half of the limits. While
+        // conflating, the queue is kept short and only drains when the
+        // subscriber keeps up again.
+        if (slow_subscriber_reported_ && !slow_subscriber_conflating_
+                && !exceedsSlowSubscriberPolicy(write_lag * 2, pending_bytes_ * 2))
+        {
+            std::cout << "PublisherSession " << endpointToString() 
+                << ": Slow subscriber has caught up." << std::endl;
+            resetSlowSubscriber();
+        }
+
+        SendQueue* next_send_queue = nextSendQueue();
+        if (replay_position_ < replay_buffers_.size())
+        {
+            // The replay uses up credit, but does not wait for it
+            const std::shared_ptr<Buffer> cached_buffer = std::move(replay_buffers_[replay_position_++]);
+            if (replay_position_ == replay_buffers_.size())
+            {
+                replay_buffers_.clear();
+                replay_position_ = 0;
+            }
+            consumeSendCredit(*cached_buffer, 0);
+            sendBufferToClient(cached_buffer);
+        }
+        else if (next_send_queue && hasSendCredit())
+        {
+            auto next_buffer_tmp = popSendQueueFront(*next_send_queue);
+            consumeSendCredit(*next_buffer_tmp, 0);
+            sendBufferToClient(next_buffer_tmp);
+        }
+        else
+        {
+            // Waiting for credit is not a slow socket, the subscriber decides
+            // how far ahead we may be
+            sending_in_progress_ = false;
+            if (slow_subscriber_reported_)
+                resetSlowSubscriber();
+
+            // Idle, the deficit is not carried over to the next busy period
+            if (egress_limiter_)
+                egress_limiter_->release(this);
+        }
+    }
+}
+
+void PublisherSession::addSendCredit(const CreditGrantMessage& credit_grant)
+{
+    std::lock_guard<std::mutex> next_buffer_lock(next_buffer_mutex_);
+
+    const uint64_t messages = std::min<uint64_t>(le64toh(credit_grant.messages), kMaxSendCredit);
+    const uint64_t bytes = std::min<uint64_t>(le64toh(credit_grant.bytes), kMaxSendCredit);
+    message_credit_ = std::min<int64_t>(message_credit_ + static_cast<int64_t>(messages), kMaxSendCredit);
+    byte_credit_ = std::min<int64_t>(byte_credit_ + static_cast<int64_t>(bytes), kMaxSendCredit);
+
+    SendQueue* next_send_queue = nextSendQueue();
+    if ((state_ == State::Running) && !sending_in_progress_ 
+            && next_send_queue && hasSendCredit())
+    {
+        sending_in_progress_ = true;
+        last_write_progress_ = std::chrono::steady_clock::now();
+        armSlowSubscriberTimer();
+        auto next_buffer_tmp = popSendQueueFront(*next_send_queue);
+        consumeSendCredit(*next_buffer_tmp, 0);
+        sendBufferToClient(next_buffer_tmp);
+    }
+}
+
+bool PublisherSession::hasSendCredit() const
+{
+    return (!message_credit_limited_ || (message_credit_ > 0))
+        && (!byte_credit_limited_ || (byte_credit_ > 0));
+}
+
+void PublisherSession::consumeSendCredit(const Buffer& buffer, size_t offset)
+{
+    if (message_credit_limited_)
+        message_credit_ -= static_cast<int64_t>(countFrames(buffer, offset));
+    if (byte_credit_limited_)
+        byte_credit_ -= static_cast<int64_t>(buffer.size() - offset);
+}
+
+uint64_t PublisherSession::countFrames(const Buffer& buffer, size_t offset)
+{
+    // A buffer holds one frame, or several back to back (sendBatch(), late
+    // joiner cache replay)
+    uint64_t frame_count = 0;
+    while (offset + sizeof(TCPHeader) <= buffer.size())
+    {
+        const TCPHeader* header = reinterpret_cast<const TCPHeader*>(buffer.data() + offset);
+        offset += le16toh(header->header_size) + le64toh(header->data_size);
+        frame_count++;
+    }
+    return frame_count;
+}
+
+void PublisherSession::enableZeroCopy()
+{
+#if STPS_HAS_ZEROCOPY
+    const int one = 1;
+    if (::setsockopt(data_socket_.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0)
+    {
+        std::cout << "PublisherSession " << endpointToString() 
+            << ": Failed enabling SO_ZEROCOPY: " << std::strerror(errno) 
+            << ". Falling back to regular sending." << std::endl;
+        zerocopy_threshold_ = 0;
+        return;
+    }
+
+    system::error_code ec;
+    data_socket_.native_non_blocking(true, ec);
+    if (ec)
+    {
+        std::cout << "PublisherSession " << endpointToString() 
+            << ": Failed setting socket non-blocking: " << ec.message()
+            << ". Falling back to regular sending." << std::endl;
+        zerocopy_threshold_ = 0;
+    }
+#else
+    std::cout << "PublisherSession " << endpointToString() 
+        << ": MSG_ZEROCOPY is not supported on this platform." << std::endl;
+    zerocopy_threshold_ = 0;
+#endif
+}
+
+void PublisherSession::armZeroCopyCompletionWait()
+{
+    if (zerocopy_completion_wait_armed_ || (state_ == State::Canceled)) return;
+
+    zerocopy_completion_wait_armed_ = true;
+    data_socket_.async_wait(asio::ip::tcp::socket::wait_error,
+            data_strand_.wrap([me = shared_from_this()](system::error_code ec)
+                {
+                    me->handler_statistics_->count(HandlerSource::PublisherWrite);
+                    me->zerocopy_completion_wait_armed_ = false;
+                    if (ec)
+                    {
+                        return;
+                    }
+                    me->reapZeroCopyCompletions();
+                }));
+}
+
+void PublisherSession::reapZeroCopyCompletions()
+{
+#if STPS_HAS_ZEROCOPY
+    // Armed before the error queue is read. The socket's error events are
+    // edge triggered, a notification that arrived after reading and before
+    // arming would not complete the wait.
+    if (!zerocopy_pending_buffers_.empty())
+    {
+        armZeroCopyCompletionWait();
+    }
+
+    for (;;)
+    {
+        char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+        msghdr message{};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        if (::recvmsg(data_socket_.native_handle(), &message, MSG_ERRQUEUE) < 0)
+        {
+            break;
+        }
+
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg))
+        {
+            const bool is_ip_error = ((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_RECVERR))
+                || ((cmsg->cmsg_level == SOL_IPV6) && (cmsg->cmsg_type == IPV6_RECVERR));
+            if (!is_ip_error)
+            {
+                continue;
+            }
+
+            sock_extended_err extended_error;
+            std::memcpy(&extended_error, CMSG_DATA(cmsg), sizeof(extended_error));
+            if ((extended_error.ee_errno != 0) || (extended_error.ee_origin != SO_EE_ORIGIN_ZEROCOPY))
+            {
+                continue;
+            }
+
+            // The notification covers the inclusive id range [ee_info, ee_data]
+            const uint32_t first_id = extended_error.ee_info;
+            const uint32_t range_length = extended_error.ee_data - first_id;
+            zerocopy_pending_buffers_.erase(
+                    std::remove_if(zerocopy_pending_buffers_.begin(), zerocopy_pending_buffers_.end(),
+                        [first_id, range_length](const auto& pending_buffer) -> bool
+                        {
+                            return static_cast<uint32_t>(pending_buffer.first - first_id) <= range_length;
+                        }),
+                    zerocopy_pending_buffers_.end());
+        }
+    }
+#endif
+}
+
+void PublisherSession::closeSocketAfterZeroCopyCompletions()
+{
+#if STPS_HAS_ZEROCOPY
+    reapZeroCopyCompletions();
+
+    if (!zerocopy_pending_buffers_.empty())
+    {
+        // The kernel may still read from the pending buffers, and their
+        // completions can only be received while the socket is open. Stop
+        // using it, and keep the buffers away from the pool until the
+        // completions have arrived.
+        system::error_code ec;
+        if (!zerocopy_drain_timer_armed_)
+        {
+            data_socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+            zerocopy_drain_deadline_ = std::chrono::steady_clock::now() + kZeroCopyDrainTimeout;
+        }
+
+        if (std::chrono::steady_clock::now() < zerocopy_drain_deadline_)
+        {
+            zerocopy_drain_timer_armed_ = true;
+            zerocopy_drain_timer_.expires_after(kZeroCopyDrainInterval);
+            zerocopy_drain_timer_.async_wait(data_strand_.wrap([me = shared_from_this()](system::error_code)
+                        {
+                            me->handler_statistics_->count(HandlerSource::Timer);
+                            me->closeSocketAfterZeroCopyCompletions();
+                        }));
+            return;
+        }
+
+        // Resetting the connection discards the unsent data, which releases
+        // the pages
+        std::cout << "PublisherSession " << endpointToString() << ": "
+            << zerocopy_pending_buffers_.size() << " zero-copy sends not completed after "
+            << kZeroCopyDrainTimeout.count() << " ms. Resetting the connection." << std::endl;
+        data_socket_.set_option(asio::socket_base::linger(true, 0), ec);
+    }
+#endif
+
+    system::error_code ec;
+    data_socket_.close(ec);
+    zerocopy_pending_buffers_.clear();
 }
 
 asio::ip::tcp::socket& PublisherSession::getSocket()
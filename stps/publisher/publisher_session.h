@@ -1,12 +1,28 @@
 #pragma once
 
+#include <stps/buffer.h>
+#include <stps/handler_memory.h>
 #include <stps/tcp_header.h>
+#include <stps/protocol_handshake_message.h>
+#include <stps/executor/handler_statistics.h>
+#include <stps/publisher/conflation_mode.h>
+#include <stps/publisher/egress_limiter_impl.h>
+#include <stps/publisher/late_joiner_cache.h>
+#include <stps/publisher/message_priority.h>
+#include <stps/publisher/slow_subscriber_policy.h>
 
-#include <boost/asio.hpp>
+#include <stps/boost_asio.h>
+#include <boost/asio/steady_timer.hpp>
 
+#include <array>
+#include <chrono>
 #include <functional>
 #include <deque>
+#include <memory_resource>
 #include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 using namespace boost;
 
@@ -25,6 +41,7 @@ namespace stps
 
 		public:
 			PublisherSession(const std::shared_ptr<asio::io_service>& io_service,
+					const std::shared_ptr<HandlerStatistics>& handler_statistics,
 					const std::function<void(const std::shared_ptr<PublisherSession>&)>& session_closed_handler);
 
 			PublisherSession(const PublisherSession&) = delete;
@@ -41,7 +58,39 @@ namespace stps
 
 			void cancel();
 
-			void sendDataBuffer(const std::shared_ptr<std::vector<char>>& buf);
+			// cache_sequence is the sequence the late joiner cache has assigned
+			// to the buffer. Buffers covered by the cache replay are skipped.
+			void sendDataBuffer(const std::shared_ptr<Buffer>& buf, uint64_t cache_sequence,
+					MessagePriority priority);
+
+			// In ConflationMode::Keyed replaces a queued buffer with the same key
+			// and priority
+			void sendKeyedDataBuffer(const std::shared_ptr<Buffer>& buf, uint64_t key, 
+					uint64_t cache_sequence, MessagePriority priority);
+
+			// Frames of at least this size are sent with MSG_ZEROCOPY. Must be set
+			// before start(); 0 disables zero-copy sending.
+			void setZeroCopyThreshold(size_t threshold);
+
+			// Number of buffers that may wait per priority while a write is in
+			// progress. When a queue is full its oldest buffer is dropped.
+			void setSendQueueSize(size_t max_queued_buffers);
+
+			void setConflationMode(ConflationMode conflation_mode);
+
+			// Its buffers are sent along with the handshake response. Must be set
+			// before start().
+			void setLateJoinerCache(const std::shared_ptr<LateJoinerCache>& late_joiner_cache);
+
+			// Returns the publisher's next sequence number, which is sent with
+			// the handshake response. Must be set before start().
+			void setNextSequenceNumberHandler(const std::function<uint64_t()>& next_sequence_number_handler);
+
+			// Every write waits for its reservation; nullptr sends unlimited
+			void setEgressLimiter(const std::shared_ptr<EgressLimiterImpl>& egress_limiter);
+
+			void setSlowSubscriberPolicy(const SlowSubscriberPolicy& policy,
+					const std::function<void(const SlowSubscriberEvent&)>& slow_subscriber_handler);
 
 			asio::ip::tcp::socket& getSocket();
 
@@ -52,14 +101,126 @@ namespace stps
 			std::string endpointToString() const;
 
 		private:
+			struct QueuedBuffer
+			{
+				std::shared_ptr<Buffer> buffer;
+				// Number of frames in the buffer, several with sendBatch()
+				uint64_t message_count;
+				bool keyed;
+				uint64_t key;
+				uint64_t cache_sequence;
+				MessagePriority priority;
+			};
+
+			static constexpr uint64_t kNotQueued = UINT64_MAX;
+
+			struct SendQueue
+			{
+				explicit SendQueue(std::pmr::memory_resource* memory)
+					: buffers(memory)
+					, key_positions(memory)
+				{}
+
+				std::pmr::deque<QueuedBuffer> buffers;
+
+				// Keyed conflation: queue positions of the queued buffer per key.
+				// The position of a buffer is its index in buffers plus the
+				// number of buffers that have left the queue before it.
+				uint64_t front_position = 0;
+				std::pmr::unordered_map<uint64_t, uint64_t> key_positions;
+				uint64_t unkeyed_position = kNotQueued;
+			};
+
+			// A peer that stopped reading keeps the zero-copy buffers pinned
+			// until TCP gives up on it. Closing is not delayed longer than this.
+			static constexpr std::chrono::milliseconds kZeroCopyDrainTimeout{10000};
+			static constexpr std::chrono::milliseconds kZeroCopyDrainInterval{10};
+
+			// Leaves room for adding a grant without overflowing
+			static constexpr int64_t kMaxSendCredit = INT64_MAX / 2;
+
 			std::shared_ptr<asio::io_service> io_service_;
+			const std::shared_ptr<HandlerStatistics> handler_statistics_;
 			std::atomic<State> state_;
+			uint8_t protocol_version_;
 			const std::function<void(const std::shared_ptr<PublisherSession>&)> session_closed_handler_;
 			asio::ip::tcp::socket data_socket_;
 			asio::io_service::strand data_strand_;
+			// One write is in flight at a time
+			HandlerMemory write_handler_memory_;
+
+			// Protected by next_buffer_mutex_
 			std::mutex next_buffer_mutex_;
 			bool sending_in_progress_;
-			std::shared_ptr<std::vector<char>> next_buffer_to_send_;
+			// The queues' blocks and nodes are reused, queueing does not
+			// allocate once the queues have been as long before
+			std::pmr::unsynchronized_pool_resource send_queue_memory_;
+			std::array<SendQueue, kMessagePriorityCount> send_queues_;
+			size_t max_buffers_to_send_;
+			ConflationMode conflation_mode_;
+
+			// Last late joiner cache sequence sent with the handshake response
+			uint64_t replayed_cache_sequence_;
+			// The cached buffers of the replay, sent after the handshake
+			// response and before any queued buffer
+			std::vector<std::shared_ptr<Buffer>> replay_buffers_;
+			size_t replay_position_;
+
+			// Flow control requested by the subscriber. The credit is the window
+			// plus the granted credit minus what has been sent; it may become
+			// negative, as a buffer is sent as a whole.
+			bool message_credit_limited_;
+			bool byte_credit_limited_;
+			int64_t message_credit_;
+			int64_t byte_credit_;
+
+			// Downsampling requested by the subscriber. Within an interval the
+			// newest buffer is held back and sent when the interval has passed.
+			uint64_t downsampling_every_nth_;
+			std::chrono::microseconds downsampling_interval_;
+			uint64_t downsampling_counter_;
+			std::chrono::steady_clock::time_point last_downsampled_send_;
+			bool downsampling_held_buffer_valid_;
+			QueuedBuffer downsampling_held_buffer_;
+			asio::steady_timer downsampling_timer_;
+			bool downsampling_timer_armed_;
+
+			size_t pending_bytes_;
+			// Of the buffer being written, as queued. Subscribers of version 0
+			// are sent a copy with shorter headers.
+			size_t sending_buffer_size_;
+			uint64_t dropped_messages_;
+			std::chrono::steady_clock::time_point last_write_progress_;
+			SlowSubscriberPolicy slow_subscriber_policy_;
+			std::function<void(const SlowSubscriberEvent&)> slow_subscriber_handler_;
+			bool slow_subscriber_reported_;
+			// SlowSubscriberAction::Conflate in effect: one buffer per queue,
+			// no keyed conflation
+			bool slow_subscriber_conflating_;
+			asio::steady_timer slow_subscriber_timer_;
+			bool slow_subscriber_timer_armed_;
+
+			std::shared_ptr<LateJoinerCache> late_joiner_cache_;
+			std::function<uint64_t()> next_sequence_number_handler_;
+
+			// Striping requested by the subscriber, protected by
+			// next_buffer_mutex_
+			uint32_t stripe_index_;
+			uint32_t stripe_count_;
+
+			// Protected by next_buffer_mutex_
+			std::shared_ptr<EgressLimiterImpl> egress_limiter_;
+			// A frame waits for limiter tokens, which is no write lag
+			bool egress_limiter_waiting_;
+
+			// Only accessed from within data_strand_
+			size_t zerocopy_threshold_;
+			uint32_t zerocopy_next_send_id_;
+			bool zerocopy_completion_wait_armed_;
+			std::deque<std::pair<uint32_t, std::shared_ptr<Buffer>>> zerocopy_pending_buffers_;
+			asio::steady_timer zerocopy_drain_timer_;
+			bool zerocopy_drain_timer_armed_;
+			std::chrono::steady_clock::time_point zerocopy_drain_deadline_;
 
 			void sessionClosedHandler();
 
@@ -74,8 +235,91 @@ namespace stps
 
 			void readPayload(const std::shared_ptr<TCPHeader>& header);
 
-			void sendProtocolHandshakeResponse();
+			void sendProtocolHandshakeResponse(const ProtocolHandshakeMessage& handshake_request);
+
+			void addSendCredit(const CreditGrantMessage& credit_grant);
+
+			bool hasSendCredit() const;
+
+			void consumeSendCredit(const Buffer& buffer, size_t offset);
+
+			static uint64_t countFrames(const Buffer& buffer, size_t offset);
+
+			void enqueueDataBuffer(const std::shared_ptr<Buffer>& buf, bool keyed, uint64_t key,
+					uint64_t cache_sequence, MessagePriority priority);
+
+			bool isReplayed(uint64_t cache_sequence) const;
+
+			// Whether the frame belongs to the stripe of this connection
+			bool isOwnStripe(uint64_t sequence_number) const;
+
+			// Returns a buffer with the frames for which keep_frame(header)
+			// returns true: the buffer itself if all are kept, a copy if some
+			// are and nullptr if none is
+			template <typename KeepFrame>
+			static std::shared_ptr<Buffer> selectFrames(const std::shared_ptr<Buffer>& buffer, 
+					KeepFrame keep_frame);
+
+			// Called with next_buffer_mutex_ held
+			void queueDataBuffer(const QueuedBuffer& queued_buffer);
+
+			// Returns false if the buffer is skipped or held back for now.
+			// Downsampling applies to the messages of a batch one by one, so the
+			// buffer may be replaced by one holding fewer frames.
+			bool passDownsampling(QueuedBuffer& queued_buffer);
+
+			void sendHeldDownsampledBuffer();
+
+			bool replaceQueuedBuffer(SendQueue& send_queue, const QueuedBuffer& queued_buffer);
+
+			void rebuildQueuedKeyPositions(SendQueue& send_queue);
+
+			void removeReplayedBuffers();
+
+			// The highest priority queue holding a buffer, nullptr if all are empty
+			SendQueue* nextSendQueue();
+
+			std::shared_ptr<Buffer> popSendQueueFront(SendQueue& send_queue);
+
+			void sendBufferToClient(const std::shared_ptr<Buffer>& buf);
+
+			// The frames with the header of protocol version 0, which has no
+			// sequence number
+			static std::shared_ptr<Buffer> createVersion0Frames(const Buffer& buffer);
+
+			void writeBufferToClient(const std::shared_ptr<Buffer>& buf);
+
+			void sendBufferToClientCopying(const std::shared_ptr<Buffer>& buf, size_t offset);
+
+			void sendBufferToClientZeroCopy(const std::shared_ptr<Buffer>& buf, size_t offset);
+
+			void bufferSentHandler(const std::shared_ptr<Buffer>& buffer);
+
+			void trimSendQueue();
+
+			bool isKeyedConflation() const;
+
+			size_t maxQueuedBuffers() const;
+
+			bool exceedsSlowSubscriberPolicy(std::chrono::milliseconds write_lag, size_t pending_bytes) const;
+
+			void checkSlowSubscriber();
+
+			// Checks the write lag while a write is in progress, also when
+			// nothing new is enqueued
+			void armSlowSubscriberTimer();
+
+			// Undoes the action and re-arms the detection
+			void resetSlowSubscriber();
+
+			void enableZeroCopy();
+
+			void armZeroCopyCompletionWait();
+
+			void reapZeroCopyCompletions();
 
-			void sendBufferToClient(const std::shared_ptr<std::vector<char>>& buf);
+			// Closes the socket once the kernel has released all buffers sent
+			// with MSG_ZEROCOPY, or after kZeroCopyDrainTimeout
+			void closeSocketAfterZeroCopyCompletions();
 	};
 } // namespace stps
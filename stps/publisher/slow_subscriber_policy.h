@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+
+namespace stps
+{
+
+// Conflate keeps only the latest message per priority while the subscriber
+// is slow, regardless of the send queue size and ConflationMode::Keyed.
+// With the default send queue size that is the regular behavior.
+enum class SlowSubscriberAction : uint8_t
+{
+	Warn = 0,
+	Conflate = 1,
+	Disconnect = 2
+};
+
+// A subscriber is considered slow once either limit is exceeded, also while
+// the publisher is not sending. A limit of 0 is not checked, so the default
+// policy never triggers. The subscriber has caught up once nothing is left
+// to send or, except with Conflate, a write completes within half of the
+// limits. Conflate is then undone and the subscriber may be reported again.
+// Waiting for flow control credit or for the tokens of an egress limiter is
+// not checked, the write lag starts once the write does.
+struct SlowSubscriberPolicy
+{
+	std::chrono::milliseconds max_write_lag{0};
+	size_t max_pending_bytes = 0;
+	SlowSubscriberAction action = SlowSubscriberAction::Warn;
+};
+
+struct SlowSubscriberEvent
+{
+	std::string subscriber_endpoint;
+	std::chrono::milliseconds write_lag{0};
+	size_t pending_bytes = 0;
+	uint64_t dropped_messages = 0;
+	SlowSubscriberAction action = SlowSubscriberAction::Warn;
+};
+
+} // namespace stps
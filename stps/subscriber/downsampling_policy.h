@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+
+namespace stps
+{
+
+// Asks the publisher to send fewer messages, for subscribers that only need a
+// sample of a fast feed. The publisher sends only every Nth message (counting
+// the messages of a sendBatch() one by one) and of those at most one per
+// min_interval, from a batch its newest message. Within
+// an interval the newest message is held back and sent once the interval has
+// passed, so the last value of a burst is never lost.
+//
+// Skipped messages show up as missed messages. 0 (and 1 for every_nth)
+// disables the respective limit. Publishers older than protocol version 3
+// send every message.
+struct DownsamplingPolicy
+{
+	uint64_t every_nth = 0;
+	std::chrono::microseconds min_interval{0};
+};
+
+} // namespace stps
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace stps
+{
+
+// Credit based flow control. The publisher only sends as many messages and
+// bytes ahead as the windows allow; the subscriber grants them back once a
+// message has been consumed: its callback has returned (also in asynchronous
+// mode), it has been polled, or the coroutine that received it awaits again.
+// A message the subscriber drops is granted back as well; with a window of
+// messages no larger than the poll or receive queue size (1 in asynchronous
+// mode) a slow consumer throttles the publisher without any drops. The
+// windows apply to every connection, so a striped session has stripe count
+// times as many messages in flight. Messages
+// the publisher may not send yet wait in its send queue, where its queue size
+// and conflation mode apply.
+//
+// A window of 0 is unlimited, both 0 disables flow control. Publishers older
+// than protocol version 2 send without flow control.
+struct FlowControlPolicy
+{
+	uint64_t window_messages = 0;
+	uint64_t window_bytes = 0;
+};
+
+} // namespace stps
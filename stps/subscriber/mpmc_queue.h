@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+namespace stps
+{
+// Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's
+// array queue). Every cell carries a sequence number that tells producers and
+// consumers whether it is free or filled for their lap, so both sides only
+// contend on their own position counter.
+template <typename T>
+class MpmcQueue
+{
+    public:
+        // The capacity is rounded up to a power of two, at least 2
+        explicit MpmcQueue(size_t capacity)
+            : capacity_(roundUpCapacity(capacity))
+            , mask_(capacity_ - 1)
+            , cells_(new Cell[capacity_])
+            , enqueue_position_(0)
+            , dequeue_position_(0)
+        {
+            for (size_t i = 0; i < capacity_; i++)
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MpmcQueue(const MpmcQueue&) = delete;
+
+        MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+        size_t capacity() const
+        {
+            return capacity_;
+        }
+
+        // Returns false if the queue is full
+        bool tryPush(T&& value)
+        {
+            Cell* cell;
+            size_t position = enqueue_position_.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                cell = &cells_[position & mask_];
+                const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (difference == 0)
+                {
+                    if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = enqueue_position_.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->value = std::move(value);
+            cell->sequence.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Returns false if the queue is empty
+        bool tryPop(T& value)
+        {
+            Cell* cell;
+            size_t position = dequeue_position_.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                cell = &cells_[position & mask_];
+                const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+                if (difference == 0)
+                {
+                    if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = dequeue_position_.load(std::memory_order_relaxed);
+                }
+            }
+
+            value = std::move(cell->value);
+            // Do not keep e.g. a buffer alive until the cell is reused
+            cell->value = T();
+            cell->sequence.store(position + capacity_, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        static size_t roundUpCapacity(size_t capacity)
+        {
+            size_t rounded_capacity = 2;
+            while (rounded_capacity < capacity)
+                rounded_capacity *= 2;
+            return rounded_capacity;
+        }
+
+        const size_t capacity_;
+        const size_t mask_;
+        const std::unique_ptr<Cell[]> cells_;
+
+        // On cache lines of their own, so producers and consumers do not
+        // invalidate each other's position
+        alignas(64) std::atomic<size_t> enqueue_position_;
+        alignas(64) std::atomic<size_t> dequeue_position_;
+};
+} // namespace stps
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+
+namespace stps
+{
+
+// Delay before reconnection attempt n (n >= 1):
+//   n == 1: first_retry_delay
+//   n >= 2: min(max_delay, base_delay * multiplier^(n - 2)), of which the
+//           fraction given by jitter is randomized downwards.
+struct ReconnectionPolicy
+{
+	std::chrono::milliseconds first_retry_delay{0};
+	std::chrono::milliseconds base_delay{100};
+	double multiplier = 2.0;
+	std::chrono::milliseconds max_delay{10000};
+	double jitter = 0.5;
+
+	// Resolved addresses are reused for reconnecting until they are older than
+	// this. A failing resolve falls back to the stale addresses.
+	std::chrono::seconds resolve_cache_ttl{60};
+};
+
+} // namespace stps
@@ -0,0 +1,162 @@
+#include <stps/subscriber/stripe_reassembler.h>
+
+#include <algorithm>
+#include <endian.h>
+
+namespace stps
+{
+StripeReassembler::StripeReassembler(size_t stripe_count, const DeliverHandler& deliver_handler)
+    : deliver_handler_(deliver_handler)
+    , stripes_(std::max(stripe_count, size_t(1)))
+    , next_sequence_number_(0)
+    , delivering_(false)
+{
+}
+
+size_t StripeReassembler::getStripeCount() const
+{
+    return stripes_.size();
+}
+
+void StripeReassembler::stripeConnected(size_t stripe_index, uint64_t next_sequence_number)
+{
+    std::unique_lock<std::mutex> reassembler_lock(reassembler_mutex_);
+
+    Stripe& stripe = stripes_[stripe_index];
+    stripe.connected = true;
+    if (next_sequence_number > 0)
+    {
+        stripe.passed_sequence_number = std::max(stripe.passed_sequence_number, next_sequence_number - 1);
+
+        // Frames sent before the first connection cannot be reassembled
+        if ((next_sequence_number_ == 0) && (statistics_.received_messages == 0))
+            next_sequence_number_ = next_sequence_number;
+    }
+
+    readyPendingFrames();
+    deliverReadyFrames(reassembler_lock);
+}
+
+void StripeReassembler::stripeDisconnected(size_t stripe_index)
+{
+    std::unique_lock<std::mutex> reassembler_lock(reassembler_mutex_);
+    stripes_[stripe_index].connected = false;
+    readyPendingFrames();
+    deliverReadyFrames(reassembler_lock);
+}
+
+void StripeReassembler::push(size_t stripe_index, const std::shared_ptr<Buffer>& buffer,
+        const std::shared_ptr<TCPHeader>& header, const std::shared_ptr<void>& credit)
+{
+    std::unique_lock<std::mutex> reassembler_lock(reassembler_mutex_);
+
+    const uint64_t sequence_number = le64toh(header->sequence_number);
+    if (sequence_number == 0)
+    {
+        // Publisher without sequence numbers, nothing to order by
+        ready(sequence_number, buffer, readyHeader(header), credit);
+        deliverReadyFrames(reassembler_lock);
+        return;
+    }
+
+    Stripe& stripe = stripes_[stripe_index];
+    stripe.passed_sequence_number = std::max(stripe.passed_sequence_number, sequence_number);
+
+    // Duplicates of the late joiner cache replay of every stripe and frames
+    // that were given up on already
+    if (((next_sequence_number_ != 0) && (sequence_number < next_sequence_number_))
+            || (pending_frames_.count(sequence_number) > 0))
+    {
+        readyPendingFrames();
+    }
+    else if ((sequence_number == next_sequence_number_) && pending_frames_.empty())
+    {
+        ready(sequence_number, buffer, readyHeader(header), credit);
+    }
+    else
+    {
+        pending_frames_.emplace(sequence_number, PendingFrame{buffer, std::make_shared<TCPHeader>(*header), credit});
+        readyPendingFrames();
+    }
+
+    deliverReadyFrames(reassembler_lock);
+}
+
+void StripeReassembler::readyPendingFrames()
+{
+    while (!pending_frames_.empty())
+    {
+        auto first_pending = pending_frames_.begin();
+        const uint64_t sequence_number = first_pending->first;
+
+        if (sequence_number != next_sequence_number_)
+        {
+            for (const auto& stripe : stripes_)
+            {
+                if (stripe.connected && (stripe.passed_sequence_number < sequence_number))
+                    return;
+            }
+        }
+
+        const PendingFrame pending_frame = std::move(first_pending->second);
+        pending_frames_.erase(first_pending);
+        ready(sequence_number, pending_frame.buffer, pending_frame.header, pending_frame.credit);
+    }
+}
+
+std::shared_ptr<TCPHeader> StripeReassembler::readyHeader(const std::shared_ptr<TCPHeader>& header) const
+{
+    // The stripe reuses the header for its next frame, another thread that
+    // is delivering may not get to this frame before
+    return (delivering_ ? std::make_shared<TCPHeader>(*header) : header);
+}
+
+void StripeReassembler::ready(uint64_t sequence_number, const std::shared_ptr<Buffer>& buffer,
+        const std::shared_ptr<TCPHeader>& header, const std::shared_ptr<void>& credit)
+{
+    statistics_.received_messages++;
+    if (sequence_number == 0)
+    {
+        ready_frames_.push_back(ReadyFrame{buffer, header, 0, credit});
+        return;
+    }
+
+    const uint64_t missed_messages = ((next_sequence_number_ != 0) && (sequence_number > next_sequence_number_) 
+            ? sequence_number - next_sequence_number_ : 0);
+
+    next_sequence_number_ = sequence_number + 1;
+    statistics_.missed_messages += missed_messages;
+    statistics_.last_sequence_number = sequence_number;
+
+    ready_frames_.push_back(ReadyFrame{buffer, header, missed_messages, credit});
+}
+
+void StripeReassembler::deliverReadyFrames(std::unique_lock<std::mutex>& reassembler_lock)
+{
+    // A single delivering thread keeps the frames of all stripes in order
+    if (delivering_) return;
+
+    delivering_ = true;
+    while (!ready_frames_.empty())
+    {
+        delivering_frames_.swap(ready_frames_);
+        reassembler_lock.unlock();
+
+        for (const auto& ready_frame : delivering_frames_)
+        {
+            deliver_handler_(ready_frame.buffer, ready_frame.header, 
+                    ready_frame.missed_messages, ready_frame.credit);
+        }
+        delivering_frames_.clear();
+
+        reassembler_lock.lock();
+    }
+    delivering_ = false;
+}
+
+SubscriberSessionStatistics StripeReassembler::getStatistics() const
+{
+    std::lock_guard<std::mutex> reassembler_lock(reassembler_mutex_);
+    return statistics_;
+}
+} // namespace stps
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stps/buffer.h>
+#include <stps/tcp_header.h>
+#include <stps/subscriber/subscriber_session.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace stps
+{
+// Merges the frames of the connections of a striped session back into
+// sequence number order. Every connection delivers its frames in order, so a
+// missing sequence number is given up on once every connected stripe has
+// passed it.
+//
+// The deliver handler is called without the lock held, by one thread at a
+// time. A stripe whose frames became ready while another one delivers leaves
+// them to that one.
+class StripeReassembler
+{
+    public:
+        using DeliverHandler = std::function<void(const std::shared_ptr<Buffer>&,
+                const std::shared_ptr<TCPHeader>&, uint64_t missed_messages,
+                const std::shared_ptr<void>& credit)>;
+
+        StripeReassembler(size_t stripe_count, const DeliverHandler& deliver_handler);
+
+        StripeReassembler(const StripeReassembler&) = delete;
+
+        StripeReassembler& operator=(const StripeReassembler&) = delete;
+
+        size_t getStripeCount() const;
+
+        // next_sequence_number is the publisher's next sequence number at the
+        // handshake, 0 if it does not send one
+        void stripeConnected(size_t stripe_index, uint64_t next_sequence_number);
+
+        void stripeDisconnected(size_t stripe_index);
+
+        // The header is copied if the frame has to wait. The flow control
+        // credit of the stripe is released with a dropped frame.
+        void push(size_t stripe_index, const std::shared_ptr<Buffer>& buffer,
+                const std::shared_ptr<TCPHeader>& header, const std::shared_ptr<void>& credit);
+
+        SubscriberSessionStatistics getStatistics() const;
+
+    private:
+        struct Stripe
+        {
+            bool connected = false;
+
+            // The stripe will not deliver any lower sequence number
+            uint64_t passed_sequence_number = 0;
+        };
+
+        struct PendingFrame
+        {
+            std::shared_ptr<Buffer> buffer;
+            std::shared_ptr<TCPHeader> header;
+            std::shared_ptr<void> credit;
+        };
+
+        struct ReadyFrame
+        {
+            std::shared_ptr<Buffer> buffer;
+            std::shared_ptr<TCPHeader> header;
+            uint64_t missed_messages;
+            std::shared_ptr<void> credit;
+        };
+
+        const DeliverHandler deliver_handler_;
+
+        mutable std::mutex reassembler_mutex_;
+        std::vector<Stripe> stripes_;
+        std::map<uint64_t, PendingFrame> pending_frames_;
+
+        // 0 until known
+        uint64_t next_sequence_number_;
+        SubscriberSessionStatistics statistics_;
+
+        // In order, to be passed to the deliver handler
+        std::vector<ReadyFrame> ready_frames_;
+        bool delivering_;
+        // Only used by the delivering thread
+        std::vector<ReadyFrame> delivering_frames_;
+
+        // Readies the pending frames that are next or whose predecessors are
+        // given up on
+        void readyPendingFrames();
+
+        // The header passed to push() is only valid during the call
+        std::shared_ptr<TCPHeader> readyHeader(const std::shared_ptr<TCPHeader>& header) const;
+
+        void ready(uint64_t sequence_number, const std::shared_ptr<Buffer>& buffer,
+                const std::shared_ptr<TCPHeader>& header, const std::shared_ptr<void>& credit);
+
+        // Calls the deliver handler with the ready frames unless another
+        // thread does already. Unlocks the lock in between.
+        void deliverReadyFrames(std::unique_lock<std::mutex>& reassembler_lock);
+};
+} // namespace stps
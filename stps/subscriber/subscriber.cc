@@ -3,6 +3,11 @@
 #include <stps/executor/executor.h>
 #include <stps/executor/executor_impl.h>
 
+#ifdef STPS_HAS_COROUTINES
+#include <boost/asio/post.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#endif
+
 namespace stps
 {
 Subscriber::Subscriber(const std::shared_ptr<Executor>& executor)
@@ -27,6 +32,31 @@ std::vector<std::shared_ptr<SubscriberSession>> Subscriber::getSessions() const
     return subscriber_impl_->getSessions();
 }
 
+void Subscriber::setReconnectionPolicy(const ReconnectionPolicy& reconnection_policy)
+{
+    subscriber_impl_->setReconnectionPolicy(reconnection_policy);
+}
+
+void Subscriber::setFlowControlPolicy(const FlowControlPolicy& flow_control_policy)
+{
+    subscriber_impl_->setFlowControlPolicy(flow_control_policy);
+}
+
+void Subscriber::setDownsamplingPolicy(const DownsamplingPolicy& downsampling_policy)
+{
+    subscriber_impl_->setDownsamplingPolicy(downsampling_policy);
+}
+
+void Subscriber::setStripeCount(size_t stripe_count)
+{
+    subscriber_impl_->setStripeCount(stripe_count);
+}
+
+void Subscriber::setBufferArena(const std::shared_ptr<BufferArena>& buffer_arena)
+{
+    subscriber_impl_->setBufferArena(buffer_arena);
+}
+
 void Subscriber::setCallback(const std::function<void(const CallbackData& callback_data)>& callback_function, bool synchronous_execution)
 {
     subscriber_impl_->setCallback(callback_function, synchronous_execution);
@@ -37,6 +67,53 @@ void Subscriber::clearCallback()
     subscriber_impl_->setCallback([](const auto&){}, true);
 }
 
+void Subscriber::setPollQueueSize(size_t max_queued_messages)
+{
+    subscriber_impl_->setPollQueueSize(max_queued_messages);
+}
+
+bool Subscriber::tryReceive(CallbackData& callback_data)
+{
+    return subscriber_impl_->tryReceive(callback_data);
+}
+
+size_t Subscriber::poll(size_t max_messages, std::vector<CallbackData>& messages)
+{
+    return subscriber_impl_->poll(max_messages, messages);
+}
+
+#ifdef STPS_HAS_COROUTINES
+void Subscriber::setReceiveQueueSize(size_t max_queued_messages)
+{
+    subscriber_impl_->setReceiveQueueSize(max_queued_messages);
+}
+
+boost::asio::awaitable<CallbackData> Subscriber::receive()
+{
+    // The handler of the coroutine is move only and must not resume the
+    // coroutine from the session thread that completes the receive
+    return boost::asio::async_initiate<const boost::asio::use_awaitable_t<>&,
+              void(boost::system::error_code, CallbackData)>(
+                      [subscriber_impl = subscriber_impl_](auto handler)
+                      {
+                          auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+                          subscriber_impl->asyncReceive(
+                                  [shared_handler](boost::system::error_code ec, CallbackData callback_data,
+                                      const std::shared_ptr<void>& credit)
+                                  {
+                                      // The coroutine consumes the message until it awaits again,
+                                      // the flow control credit is granted afterwards
+                                      boost::asio::post(boost::asio::get_associated_executor(*shared_handler),
+                                              [shared_handler, ec, callback_data = std::move(callback_data), credit = credit]() mutable
+                                              {
+                                                  (*shared_handler)(ec, std::move(callback_data));
+                                                  credit.reset();
+                                              });
+                                  });
+                      }, boost::asio::use_awaitable);
+}
+#endif
+
 void Subscriber::cancel()
 {
     subscriber_impl_->cancel();
@@ -1,14 +1,20 @@
 #pragma once
 
 #include <stps/executor/executor.h>
+#include <stps/memory/buffer_arena.h>
 #include <stps/subscriber/subscriber_session.h>
+#include <stps/subscriber/reconnection_policy.h>
+#include <stps/subscriber/flow_control_policy.h>
+#include <stps/subscriber/downsampling_policy.h>
 #include <stps/callback_data.h>
+#include <stps/coroutine.h>
 
 #include <functional>
 #include <stdint.h>
 #include <memory>
 #include <chrono>
 #include <string>
+#include <vector>
 
 namespace stps
 {
@@ -28,9 +34,43 @@ class Subscriber
        std::shared_ptr<SubscriberSession> addSession(const std::string& address, uint16_t port, 
                int max_reconnection_attemps = -1);
        std::vector<std::shared_ptr<SubscriberSession>> getSessions() const;
+       // Applies to sessions added afterwards
+       void setReconnectionPolicy(const ReconnectionPolicy& reconnection_policy);
+       // Applies to sessions added afterwards
+       void setFlowControlPolicy(const FlowControlPolicy& flow_control_policy);
+       // Applies to sessions added afterwards
+       void setDownsamplingPolicy(const DownsamplingPolicy& downsampling_policy);
+       // Applies to sessions added afterwards. Each session opens stripe_count
+       // connections to the publisher, which spreads the frames over them;
+       // the subscriber delivers them in sequence number order again. Frames
+       // are not split, a single frame is sent over one connection.
+       void setStripeCount(size_t stripe_count);
+       // Receive buffers the pool allocates afterwards come from the arena,
+       // idle pooled buffers are released. nullptr goes back to the heap.
+       void setBufferArena(const std::shared_ptr<BufferArena>& buffer_arena);
        void setCallback(const std::function<void(const CallbackData& callback_data)>& callback_function, 
                bool synchronous_execution = false);
        void clearCallback();
+       // While max_queued_messages > 0, received messages are queued for
+       // tryReceive() and poll() instead of being passed to the callback. The
+       // queue is lock-free and the polling thread is never woken up. A full
+       // queue drops its oldest message, counted in dropped_callbacks_ of the
+       // next polled one.
+       void setPollQueueSize(size_t max_queued_messages);
+       // Returns false if no message is queued
+       bool tryReceive(CallbackData& callback_data);
+       // Appends up to max_messages queued messages, returns their number
+       size_t poll(size_t max_messages, std::vector<CallbackData>& messages);
+#ifdef STPS_HAS_COROUTINES
+       // While max_queued_messages > 0, received messages are queued for
+       // receive() instead of being passed to the callback. A full queue drops
+       // its oldest message, counted in dropped_callbacks_ of the next one.
+       void setReceiveQueueSize(size_t max_queued_messages);
+       // Completes with the next queued message on the executor of the
+       // awaiting coroutine. Throws boost::system::system_error with
+       // operation_aborted when the subscriber is canceled.
+       boost::asio::awaitable<CallbackData> receive();
+#endif
        void cancel();
     private:
        std::shared_ptr<SubscriberImpl> subscriber_impl_;
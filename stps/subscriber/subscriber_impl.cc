@@ -4,15 +4,30 @@
 #include <endian.h>
 #include <stps/subscriber/subscriber_session_impl.h>
 #include <stps/executor/executor_impl.h>
+#include <stps/tracing/probes.h>
+#include <stps/tracing/tracing.h>
 
 namespace stps
 {
   SubscriberImpl::SubscriberImpl(const std::shared_ptr<Executor>& executor)
     : executor_                    (executor)
+    , stripe_count_                (1)
+    , poll_queue_                  (nullptr)
+    , poll_dropped_callbacks_      (0)
+    , poll_dropped_missed_messages_(0)
+    , max_queued_messages_         (0)
     , user_callback_is_synchronous_(true)
     , synchronous_user_callback_   ([](const auto&){})
     , callback_thread_stop_        (true)
-  {}
+    , buffer_arena_enabled_        (false)
+    , buffer_pool_                 ([this]()
+                                    {
+                                      STPS_PROBE1(subscriber_pool_miss, this);
+                                      return BufferArena::createBuffer(std::atomic_load(&buffer_arena_));
+                                    })
+  {
+    buffer_memory_component_ = executor_->executor_impl_->createBufferMemoryComponent("Subscriber " + subscriberIdString());
+  }
 
   SubscriberImpl::~SubscriberImpl()
   {
@@ -21,10 +36,10 @@ namespace stps
   std::shared_ptr<SubscriberSession> SubscriberImpl::addSession(const std::string& address, uint16_t port, int max_reconnection_attempts)
   {
 
-    std::function<std::shared_ptr<std::vector<char>>()> get_free_buffer_handler
-            = [me = shared_from_this()]() -> std::shared_ptr<std::vector<char>>
+    std::function<std::shared_ptr<Buffer>()> get_free_buffer_handler
+            = [me = shared_from_this()]() -> std::shared_ptr<Buffer>
               {
-                return me->buffer_pool_.allocate();
+                return me->allocateBuffer();
               };
 
     std::function<void(const std::shared_ptr<SubscriberSessionImpl>&)> subscriber_session_closed_handler
@@ -35,9 +50,16 @@ namespace stps
                 auto session_it = std::find_if(me->session_list_.begin()
                                               , me->session_list_.end()
                                               , [&subscriber_session_impl] (const std::shared_ptr<SubscriberSession>& session) ->bool
-                                                { return subscriber_session_impl == session->subscriber_session_impl_; });
+                                                { 
+                                                  return (subscriber_session_impl == session->subscriber_session_impl_)
+                                                    || (std::find(session->stripe_session_impls_.begin()
+                                                                , session->stripe_session_impls_.end()
+                                                                , subscriber_session_impl) != session->stripe_session_impls_.end());
+                                                });
                 if (session_it != me->session_list_.end())
                 {
+                  // A striped session cannot continue without one of its stripes
+                  (*session_it)->cancel();
                   me->session_list_.erase(session_it);
                 }
                 else
@@ -45,20 +67,62 @@ namespace stps
                 }
               };
 
+    ReconnectionPolicy reconnection_policy;
+    FlowControlPolicy flow_control_policy;
+    DownsamplingPolicy downsampling_policy;
+    size_t stripe_count;
+    {
+      std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
+      reconnection_policy = reconnection_policy_;
+      flow_control_policy = flow_control_policy_;
+      downsampling_policy = downsampling_policy_;
+      stripe_count        = stripe_count_;
+    }
+
+    // The stripes deliver through the reassembler, which restores the order
+    // of the sequence numbers
+    std::shared_ptr<StripeReassembler> stripe_reassembler;
+    if (stripe_count > 1)
+    {
+      stripe_reassembler = std::make_shared<StripeReassembler>(stripe_count
+                                                              , [me = shared_from_this()](const std::shared_ptr<Buffer>& buffer, const std::shared_ptr<TCPHeader>& header,
+                                                                  uint64_t missed_messages, const std::shared_ptr<void>& credit)->void
+                                                                {
+                                                                  me->handleReceivedBuffer(buffer, header, missed_messages, credit);
+                                                                });
+    }
+
+    std::vector<std::shared_ptr<SubscriberSessionImpl>> subscriber_session_impls;
+    for (size_t stripe_index = 0; stripe_index < stripe_count; stripe_index++)
+    {
+      subscriber_session_impls.push_back(std::make_shared<SubscriberSessionImpl>(executor_->executor_impl_->ioService()
+                                                                                , executor_->executor_impl_->handlerStatistics()
+                                                                                , address
+                                                                                , port
+                                                                                , max_reconnection_attempts
+                                                                                , reconnection_policy
+                                                                                , flow_control_policy
+                                                                                , downsampling_policy
+                                                                                , stripe_reassembler
+                                                                                , stripe_index
+                                                                                , get_free_buffer_handler
+                                                                                , subscriber_session_closed_handler));
+    }
+
     std::shared_ptr<SubscriberSession> subscriber_session(
-       new SubscriberSession(std::make_shared<SubscriberSessionImpl>(executor_->executor_impl_->ioService()
-                                                                    , address
-                                                                    , port
-                                                                    , max_reconnection_attempts
-                                                                    , get_free_buffer_handler
-                                                                    , subscriber_session_closed_handler)));
+       new SubscriberSession(subscriber_session_impls.front()
+                            , std::vector<std::shared_ptr<SubscriberSessionImpl>>(subscriber_session_impls.begin() + 1, subscriber_session_impls.end())
+                            , stripe_reassembler));
 
     setCallbackToSession(subscriber_session);
 
     {
       std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
       session_list_.push_back(subscriber_session);
-      subscriber_session->subscriber_session_impl_->start();
+      for (const auto& subscriber_session_impl : subscriber_session_impls)
+      {
+        subscriber_session_impl->start();
+      }
     }
 
     return subscriber_session;
@@ -70,6 +134,37 @@ namespace stps
     return session_list_;
   }
 
+  void SubscriberImpl::setReconnectionPolicy(const ReconnectionPolicy& reconnection_policy)
+  {
+    std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
+    reconnection_policy_ = reconnection_policy;
+  }
+
+  void SubscriberImpl::setFlowControlPolicy(const FlowControlPolicy& flow_control_policy)
+  {
+    std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
+    flow_control_policy_ = flow_control_policy;
+  }
+
+  void SubscriberImpl::setDownsamplingPolicy(const DownsamplingPolicy& downsampling_policy)
+  {
+    std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
+    downsampling_policy_ = downsampling_policy;
+  }
+
+  void SubscriberImpl::setStripeCount(size_t stripe_count)
+  {
+    std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
+    stripe_count_ = std::max(stripe_count, size_t(1));
+  }
+
+  void SubscriberImpl::setBufferArena(const std::shared_ptr<BufferArena>& buffer_arena)
+  {
+    std::atomic_store(&buffer_arena_, buffer_arena);
+    buffer_arena_enabled_ = bool(buffer_arena);
+    buffer_pool_.free_unused();
+  }
+
   void SubscriberImpl::setCallback(const std::function<void(const CallbackData& callback_data)>& callback_function, bool synchronous_execution)
   {
 
@@ -86,20 +181,21 @@ namespace stps
       callback_thread_.reset();
     }
 
-    const bool renew_synchronous_callbacks = (synchronous_execution || user_callback_is_synchronous_);
-
     if (synchronous_execution)
     {
+      std::unique_lock<std::mutex> callback_lock(last_callback_data_mutex_);
       synchronous_user_callback_    = callback_function;
       user_callback_is_synchronous_ = synchronous_execution;
-
-      std::unique_lock<std::mutex> callback_lock(last_callback_data_mutex_);
       last_callback_data_ = CallbackData();
+      last_callback_credit_.reset();
     }
     if (!synchronous_execution)
     {
-      synchronous_user_callback_    = [](const auto&) {};
-      user_callback_is_synchronous_ = synchronous_execution;
+      {
+        std::unique_lock<std::mutex> callback_lock(last_callback_data_mutex_);
+        synchronous_user_callback_    = [](const auto&) {};
+        user_callback_is_synchronous_ = synchronous_execution;
+      }
 
       callback_thread_stop_ = false;
       callback_thread_ = std::make_unique<std::thread>(
@@ -108,6 +204,7 @@ namespace stps
                       for (;;)
                       {
                         CallbackData this_callback_data; 
+                        std::shared_ptr<void> this_callback_credit;
 
                         {
                           std::unique_lock<std::mutex> callback_lock(me->last_callback_data_mutex_);
@@ -115,52 +212,210 @@ namespace stps
 
                           if (me->callback_thread_stop_) return;
 
-                          std::swap(this_callback_data, me->last_callback_data_);                         }
+                          std::swap(this_callback_data, me->last_callback_data_);
+                          std::swap(this_callback_credit, me->last_callback_credit_);
+                        }
 
+                        STPS_TRACE(SubscriberCallbackStart, this_callback_data.buffer_.get(), nullptr, this_callback_data.buffer_->size());
                         callback_function(this_callback_data);
+                        STPS_TRACE(SubscriberCallbackEnd, this_callback_data.buffer_.get(), nullptr, this_callback_data.buffer_->size());
+
+                        // The message is consumed, the publisher may send the next one
+                        this_callback_credit.reset();
                       }
                     });
     }
+  }
+
+  void SubscriberImpl::setPollQueueSize(size_t max_queued_messages)
+  {
+    std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+    MpmcQueue<QueuedMessage>* const old_poll_queue = poll_queue_.load(std::memory_order_relaxed);
+
+    if (max_queued_messages > 0)
+    {
+      poll_queues_.push_back(std::make_unique<MpmcQueue<QueuedMessage>>(max_queued_messages));
+      poll_queue_.store(poll_queues_.back().get(), std::memory_order_release);
+    }
+    else
+    {
+      poll_queue_.store(nullptr, std::memory_order_release);
+    }
 
-    if (renew_synchronous_callbacks)
+    // Release the buffers of the messages nobody will poll anymore
+    if (old_poll_queue)
     {
-      std::lock_guard<std::mutex> session_list_lock(session_list_mutex_);
-      for (const auto& session : session_list_)
+      QueuedMessage queued_message;
+      while (old_poll_queue->tryPop(queued_message)) {}
+    }
+  }
+
+  bool SubscriberImpl::tryReceive(CallbackData& callback_data)
+  {
+    MpmcQueue<QueuedMessage>* const poll_queue = poll_queue_.load(std::memory_order_acquire);
+    QueuedMessage queued_message;
+    if (!poll_queue || !poll_queue->tryPop(queued_message)) return false;
+
+    // Polling consumes the message, its credit is granted on return
+    callback_data = std::move(queued_message.callback_data);
+
+    if (poll_dropped_callbacks_.load(std::memory_order_relaxed) > 0)
+    {
+      callback_data.dropped_callbacks_ += poll_dropped_callbacks_.exchange(0, std::memory_order_relaxed);
+      callback_data.missed_messages_   += poll_dropped_missed_messages_.exchange(0, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  size_t SubscriberImpl::poll(size_t max_messages, std::vector<CallbackData>& messages)
+  {
+    size_t polled_messages = 0;
+    CallbackData callback_data;
+    while ((polled_messages < max_messages) && tryReceive(callback_data))
+    {
+      messages.push_back(std::move(callback_data));
+      polled_messages++;
+    }
+    return polled_messages;
+  }
+
+  void SubscriberImpl::setReceiveQueueSize(size_t max_queued_messages)
+  {
+    std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+    max_queued_messages_ = max_queued_messages;
+    while (receive_queue_.size() > max_queued_messages_)
+    {
+      receive_queue_.pop_front();
+    }
+  }
+
+  void SubscriberImpl::asyncReceive(const std::function<void(system::error_code, CallbackData, const std::shared_ptr<void>&)>& receive_handler)
+  {
+    QueuedMessage queued_message;
+    {
+      std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+      if (receive_queue_.empty())
       {
-        setCallbackToSession(session);
+        receive_handlers_.push_back(receive_handler);
+        return;
       }
+      queued_message = std::move(receive_queue_.front());
+      receive_queue_.pop_front();
     }
+    receive_handler(system::error_code(), std::move(queued_message.callback_data), queued_message.credit);
   }
 
   void SubscriberImpl::setCallbackToSession(const std::shared_ptr<SubscriberSession>& session)
   {
-    if (user_callback_is_synchronous_)
+    if (session->stripe_reassembler_)
     {
-      session->subscriber_session_impl_->setSynchronousCallback(
-                [callback = synchronous_user_callback_, me = shared_from_this()](const std::shared_ptr<std::vector<char>>& buffer, const std::shared_ptr<TCPHeader>& /*header*/)->void
-                {
-                  std::lock_guard<std::mutex> callback_lock(me->last_callback_data_mutex_);
-                  if (me->user_callback_is_synchronous_)
+      std::vector<std::shared_ptr<SubscriberSessionImpl>> stripe_session_impls{session->subscriber_session_impl_};
+      stripe_session_impls.insert(stripe_session_impls.end(), session->stripe_session_impls_.begin(), session->stripe_session_impls_.end());
+
+      for (size_t stripe_index = 0; stripe_index < stripe_session_impls.size(); stripe_index++)
+      {
+        stripe_session_impls[stripe_index]->setSynchronousCallback(
+                  [stripe_reassembler = session->stripe_reassembler_, stripe_index](const std::shared_ptr<Buffer>& buffer, const std::shared_ptr<TCPHeader>& header,
+                    uint64_t, const std::shared_ptr<void>& credit)->void
                   {
-                    CallbackData callback_data;
-                    callback_data.buffer_           = buffer;
-                    callback(callback_data);
-                  }
-                });
+                    stripe_reassembler->push(stripe_index, buffer, header, credit);
+                  });
+      }
+      return;
+    }
+
+    session->subscriber_session_impl_->setSynchronousCallback(
+              [me = shared_from_this()](const std::shared_ptr<Buffer>& buffer, const std::shared_ptr<TCPHeader>& header,
+                uint64_t missed_messages, const std::shared_ptr<void>& credit)->void
+              {
+                me->handleReceivedBuffer(buffer, header, missed_messages, credit);
+              });
+  }
+
+  void SubscriberImpl::handleReceivedBuffer(const std::shared_ptr<Buffer>& buffer, const std::shared_ptr<TCPHeader>& header,
+      uint64_t missed_messages, const std::shared_ptr<void>& credit)
+  {
+    MpmcQueue<QueuedMessage>* const poll_queue = poll_queue_.load(std::memory_order_acquire);
+    if (poll_queue)
+    {
+      QueuedMessage queued_message;
+      queued_message.callback_data.buffer_          = buffer;
+      queued_message.callback_data.sequence_number_ = le64toh(header->sequence_number);
+      queued_message.callback_data.missed_messages_ = missed_messages;
+      queued_message.credit                         = credit;
+
+      // A full queue drops its oldest message, which grants its credit
+      QueuedMessage dropped_message;
+      while (!poll_queue->tryPush(std::move(queued_message)))
+      {
+        if (poll_queue->tryPop(dropped_message))
+        {
+          poll_dropped_missed_messages_.fetch_add(dropped_message.callback_data.missed_messages_ , std::memory_order_relaxed);
+          poll_dropped_callbacks_.fetch_add(dropped_message.callback_data.dropped_callbacks_ + 1, std::memory_order_relaxed);
+        }
+      }
+      return;
+    }
+
+    // Released after the lock
+    std::shared_ptr<void> dropped_credit;
+
+    std::unique_lock<std::mutex> callback_lock(last_callback_data_mutex_);
+    if (max_queued_messages_ > 0)
+    {
+      QueuedMessage queued_message;
+      queued_message.callback_data.buffer_          = buffer;
+      queued_message.callback_data.sequence_number_ = le64toh(header->sequence_number);
+      queued_message.callback_data.missed_messages_ = missed_messages;
+      queued_message.credit                         = credit;
+
+      if (!receive_handlers_.empty())
+      {
+        const auto receive_handler = std::move(receive_handlers_.front());
+        receive_handlers_.pop_front();
+        callback_lock.unlock();
+        receive_handler(system::error_code(), std::move(queued_message.callback_data), credit);
+        return;
+      }
+
+      // A full queue drops its oldest message, the next one accounts for it
+      receive_queue_.push_back(std::move(queued_message));
+      if (receive_queue_.size() > max_queued_messages_)
+      {
+        const CallbackData dropped_callback_data = std::move(receive_queue_.front().callback_data);
+        dropped_credit = std::move(receive_queue_.front().credit);
+        receive_queue_.pop_front();
+        receive_queue_.front().callback_data.missed_messages_   += dropped_callback_data.missed_messages_;
+        receive_queue_.front().callback_data.dropped_callbacks_ += dropped_callback_data.dropped_callbacks_ + 1;
+      }
+    }
+    else if (user_callback_is_synchronous_)
+    {
+      CallbackData callback_data;
+      callback_data.buffer_           = buffer;
+      callback_data.sequence_number_  = le64toh(header->sequence_number);
+      callback_data.missed_messages_  = missed_messages;
+      STPS_TRACE(SubscriberCallbackStart, buffer.get(), nullptr, buffer->size());
+      synchronous_user_callback_(callback_data);
+      STPS_TRACE(SubscriberCallbackEnd, buffer.get(), nullptr, buffer->size());
     }
     else
     {
-      session->subscriber_session_impl_->setSynchronousCallback(
-                [me = shared_from_this()](const std::shared_ptr<std::vector<char>>& buffer, const std::shared_ptr<TCPHeader>& /*header*/)->void
-                {
-                  std::lock_guard<std::mutex> callback_lock(me->last_callback_data_mutex_);
-                  if (!me->user_callback_is_synchronous_)
-                  {
-                    me->last_callback_data_.buffer_           = buffer;
+      uint64_t dropped_callbacks = 0;
+      if (last_callback_data_.buffer_)
+      {
+        STPS_TRACE(SubscriberCallbackDrop, last_callback_data_.buffer_.get(), nullptr, last_callback_data_.buffer_->size());
+        dropped_callbacks = last_callback_data_.dropped_callbacks_ + 1;
+        missed_messages  += last_callback_data_.missed_messages_;
+      }
+      last_callback_data_.buffer_            = buffer;
+      last_callback_data_.sequence_number_   = le64toh(header->sequence_number);
+      last_callback_data_.missed_messages_   = missed_messages;
+      last_callback_data_.dropped_callbacks_ = dropped_callbacks;
+      dropped_credit = std::move(last_callback_credit_);
+      last_callback_credit_ = credit;
 
-                    me->last_callback_data_cv_.notify_all();
-                  }
-                });
+      last_callback_data_cv_.notify_all();
     }
   }
 
@@ -188,8 +443,31 @@ namespace stps
       callback_thread_.reset();
     }
 
-    synchronous_user_callback_    = [](const auto&){};
-    user_callback_is_synchronous_ = true;
+    std::deque<std::function<void(system::error_code, CallbackData, const std::shared_ptr<void>&)>> receive_handlers;
+    {
+      std::lock_guard<std::mutex> callback_lock(last_callback_data_mutex_);
+      synchronous_user_callback_    = [](const auto&){};
+      user_callback_is_synchronous_ = true;
+      receive_queue_.clear();
+      std::swap(receive_handlers, receive_handlers_);
+    }
+
+    for (const auto& receive_handler : receive_handlers)
+    {
+      receive_handler(asio::error::operation_aborted, CallbackData(), nullptr);
+    }
+  }
+
+  std::shared_ptr<Buffer> SubscriberImpl::allocateBuffer()
+  {
+    STPS_PROBE1(subscriber_pool_allocate, this);
+
+    // With the executor's buffer memory, idle memory is kept there for all
+    // publishers and subscribers instead of in a pool of this subscriber
+    if (buffer_memory_component_ && !buffer_arena_enabled_)
+      return BufferMemoryComponent::createBuffer(buffer_memory_component_);
+
+    return buffer_pool_.allocate();
   }
 
   std::string SubscriberImpl::subscriberIdString() const
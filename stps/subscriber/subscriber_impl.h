@@ -7,12 +7,21 @@
 #include <functional>
 #include <thread>
 #include <condition_variable>
-#include <boost/asio.hpp>
+#include <deque>
+#include <stps/boost_asio.h>
 #include <recycle/shared_pool.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <stps/executor/executor.h>
+#include <stps/memory/buffer_arena.h>
+#include <stps/memory/buffer_memory.h>
 #include <stps/subscriber/subscriber_session.h>
+#include <stps/subscriber/reconnection_policy.h>
+#include <stps/subscriber/flow_control_policy.h>
+#include <stps/subscriber/downsampling_policy.h>
+#include <stps/subscriber/mpmc_queue.h>
+#include <stps/subscriber/stripe_reassembler.h>
 #include <stps/callback_data.h>
+#include <stps/tcp_header.h>
 
 using namespace boost;
 
@@ -32,7 +41,27 @@ class SubscriberImpl : public std::enable_shared_from_this<SubscriberImpl>
     public:
     std::shared_ptr<SubscriberSession> addSession(const std::string& address, uint16_t port, int max_reconnection_attempts);
     std::vector<std::shared_ptr<SubscriberSession>> getSessions() const;
+    void setReconnectionPolicy(const ReconnectionPolicy& reconnection_policy);
+    void setFlowControlPolicy(const FlowControlPolicy& flow_control_policy);
+    void setDownsamplingPolicy(const DownsamplingPolicy& downsampling_policy);
+    void setStripeCount(size_t stripe_count);
+    void setBufferArena(const std::shared_ptr<BufferArena>& buffer_arena);
     void setCallback(const std::function<void(const CallbackData& callback_data)>& callback_function,       bool synchronous_execution);
+    // 0 passes received messages to the callback again
+    void setPollQueueSize(size_t max_queued_messages);
+    bool tryReceive(CallbackData& callback_data);
+    size_t poll(size_t max_messages, std::vector<CallbackData>& messages);
+    // 0 passes received messages to the callback again
+    void setReceiveQueueSize(size_t max_queued_messages);
+    // The handler is called with the next queued message, from the calling
+    // thread if one is queued already, or with operation_aborted on cancel().
+    // It keeps the credit until the message has been consumed.
+    void asyncReceive(const std::function<void(system::error_code, CallbackData, const std::shared_ptr<void>&)>& receive_handler);
+    // Hands a received buffer to the user callback (synchronous mode) or to
+    // the callback thread (asynchronous mode). The credit is kept until the
+    // message has been consumed or dropped.
+    void handleReceivedBuffer(const std::shared_ptr<Buffer>& buffer, const std::shared_ptr<TCPHeader>& header,
+            uint64_t missed_messages, const std::shared_ptr<void>& credit);
   private:
     void setCallbackToSession(const std::shared_ptr<SubscriberSession>& session);
 
@@ -41,15 +70,45 @@ class SubscriberImpl : public std::enable_shared_from_this<SubscriberImpl>
 
   private:
     std::string subscriberIdString() const;
+    std::shared_ptr<Buffer> allocateBuffer();
 private:
+    // A queued message and the flow control credit of its frame, granted
+    // when the entry is destroyed
+    struct QueuedMessage
+    {
+      CallbackData          callback_data;
+      std::shared_ptr<void> credit;
+    };
+
     const std::shared_ptr<Executor>                 executor_;                 
 
     mutable std::mutex                              session_list_mutex_;
     std::vector<std::shared_ptr<SubscriberSession>> session_list_;
+    ReconnectionPolicy                              reconnection_policy_;
+    FlowControlPolicy                               flow_control_policy_;
+    DownsamplingPolicy                              downsampling_policy_;
+    size_t                                          stripe_count_;
+
+    // Queue of tryReceive() and poll(), filled by the session threads without
+    // a lock. Replaced queues are kept until destruction, as a session thread
+    // may still be pushing into one. Only replaced under
+    // last_callback_data_mutex_.
+    std::atomic<MpmcQueue<QueuedMessage>*>          poll_queue_;
+    std::vector<std::unique_ptr<MpmcQueue<QueuedMessage>>> poll_queues_;
+    // Dropped from a full poll queue, accounted in the next polled message
+    std::atomic<uint64_t>                           poll_dropped_callbacks_;
+    std::atomic<uint64_t>                           poll_dropped_missed_messages_;
 
     mutable std::mutex                              last_callback_data_mutex_;
     std::condition_variable                         last_callback_data_cv_;
     CallbackData                                    last_callback_data_;
+    std::shared_ptr<void>                           last_callback_credit_;
+
+    // Receive queue of asyncReceive(), protected by last_callback_data_mutex_.
+    // Replaces the callback while max_queued_messages_ > 0.
+    size_t                                          max_queued_messages_;
+    std::deque<QueuedMessage>                       receive_queue_;
+    std::deque<std::function<void(system::error_code, CallbackData, const std::shared_ptr<void>&)>> receive_handlers_;
 
     std::atomic<bool>                               user_callback_is_synchronous_;
     std::function<void(const CallbackData&)>        synchronous_user_callback_;
@@ -57,12 +116,20 @@ private:
     std::unique_ptr<std::thread>                    callback_thread_;
     std::atomic<bool>                               callback_thread_stop_;
 
+    // Backs the buffers of pool misses, read with std::atomic_load()
+    std::shared_ptr<BufferArena>                    buffer_arena_;
+    std::atomic<bool>                               buffer_arena_enabled_;
+
+    // The executor's buffer memory, replaces the buffer pool unless an
+    // arena is set. Only set in the constructor.
+    std::shared_ptr<BufferMemoryComponent>          buffer_memory_component_;
+
     struct BufferPoolLockPolicy
     {
       using mutex_type = std::mutex;
       using lock_type  = std::lock_guard<mutex_type>;
     };
 
-    recycle::shared_pool<std::vector<char>, BufferPoolLockPolicy> buffer_pool_;                
+    recycle::shared_pool<Buffer, BufferPoolLockPolicy> buffer_pool_;                
 };
 } // namespace stps
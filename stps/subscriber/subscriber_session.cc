@@ -1,5 +1,6 @@
 #include <stps/subscriber/subscriber_session.h>
 #include <stps/subscriber/subscriber_session_impl.h>
+#include <stps/subscriber/stripe_reassembler.h>
 
 namespace stps
 {
@@ -7,9 +8,17 @@ SubscriberSession::SubscriberSession(const std::shared_ptr<SubscriberSessionImpl
     : subscriber_session_impl_(impl)
   {}
 
+SubscriberSession::SubscriberSession(const std::shared_ptr<SubscriberSessionImpl>& impl,
+    const std::vector<std::shared_ptr<SubscriberSessionImpl>>& stripe_session_impls,
+    const std::shared_ptr<StripeReassembler>& stripe_reassembler)
+    : subscriber_session_impl_(impl)
+    , stripe_session_impls_(stripe_session_impls)
+    , stripe_reassembler_(stripe_reassembler)
+  {}
+
   SubscriberSession::~SubscriberSession()
   {
-    subscriber_session_impl_->cancel();
+    cancel();
   }
 
   std::string SubscriberSession::getAddress() const
@@ -19,8 +28,25 @@ SubscriberSession::SubscriberSession(const std::shared_ptr<SubscriberSessionImpl
     { return subscriber_session_impl_->getPort(); }
 
   void SubscriberSession::cancel()
-    { subscriber_session_impl_->cancel(); }
+  {
+    subscriber_session_impl_->cancel();
+    for (const auto& stripe_session_impl : stripe_session_impls_)
+      stripe_session_impl->cancel();
+  }
 
   bool SubscriberSession::isConnected() const
-    { return subscriber_session_impl_->isConnected(); }
+  {
+    if (!subscriber_session_impl_->isConnected()) return false;
+    for (const auto& stripe_session_impl : stripe_session_impls_)
+    {
+      if (!stripe_session_impl->isConnected()) return false;
+    }
+    return true;
+  }
+
+  SubscriberSessionStatistics SubscriberSession::getStatistics() const
+  {
+    if (stripe_reassembler_) return stripe_reassembler_->getStatistics();
+    return subscriber_session_impl_->getStatistics();
+  }
 } // namespace stps
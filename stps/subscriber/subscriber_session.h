@@ -3,11 +3,26 @@
 #include <stdint.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace stps
 {
 class SubscriberSessionImpl;
 class SubscriberImpl;
+class StripeReassembler;
+
+// Counted over all connections of the session. A striped session counts
+// the reassembled frames.
+struct SubscriberSessionStatistics
+{
+    uint64_t received_messages = 0;
+
+    // Sequence numbers that never arrived: messages the publisher dropped,
+    // conflated or downsampled for this subscriber. Only counted with protocol version 1.
+    uint64_t missed_messages = 0;
+
+    uint64_t last_sequence_number = 0;
+};
 
 class SubscriberSession
 {
@@ -24,9 +39,18 @@ class SubscriberSession
     uint16_t getPort() const;
     void cancel();
     bool isConnected() const;
+    SubscriberSessionStatistics getStatistics() const;
 
     private:
     std::shared_ptr<SubscriberSessionImpl> subscriber_session_impl_;
+
+    // The connections of stripe 1 and higher, empty if not striped
+    std::vector<std::shared_ptr<SubscriberSessionImpl>> stripe_session_impls_;
+    std::shared_ptr<StripeReassembler> stripe_reassembler_;
+
     SubscriberSession(const std::shared_ptr<SubscriberSessionImpl>& impl);
+    SubscriberSession(const std::shared_ptr<SubscriberSessionImpl>& impl,
+        const std::vector<std::shared_ptr<SubscriberSessionImpl>>& stripe_session_impls,
+        const std::shared_ptr<StripeReassembler>& stripe_reassembler);
 };
 } // namespace stps
@@ -1,26 +1,59 @@
 #include <stps/subscriber/subscriber_session_impl.h>
 
 #include <stps/protocol_handshake_message.h>
+#include <stps/tracing/probes.h>
+#include <stps/tracing/tracing.h>
 
 #include "endian.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 namespace stps
 {
 SubscriberSessionImpl::SubscriberSessionImpl(const std::shared_ptr<asio::io_service>& io_service, 
+        const std::shared_ptr<HandlerStatistics>& handler_statistics,
         const std::string& address, uint16_t port, int max_reconnection_attempts,
-        const std::function<std::shared_ptr<std::vector<char>>()>& get_buffer_handler,
+        const ReconnectionPolicy& reconnection_policy,
+        const FlowControlPolicy& flow_control_policy,
+        const DownsamplingPolicy& downsampling_policy,
+        const std::shared_ptr<StripeReassembler>& stripe_reassembler, size_t stripe_index,
+        const std::function<std::shared_ptr<Buffer>()>& get_buffer_handler,
         const std::function<void(const std::shared_ptr<SubscriberSessionImpl>&)>& session_closed_handler)
-    : address_(address)
+    : handler_statistics_(handler_statistics)
+    , address_(address)
     , port_(port)
     , resolver_(*io_service)
     , max_reconnection_attempts_(max_reconnection_attempts)
     , retries_left_(max_reconnection_attempts)
-    , retry_timer_(*io_service, std::chrono::seconds(1))
+    , reconnection_policy_(reconnection_policy)
+    , downsampling_policy_(downsampling_policy)
+    , reconnection_attempt_(0)
+    , jitter_engine_(std::random_device{}())
+    , retry_timer_(*io_service)
     , canceled_(false)
     , data_socket_(*io_service)
     , data_strand_(*io_service)
     , get_buffer_handler_(get_buffer_handler)
     , session_closed_handler_(session_closed_handler)
+    , receive_header_(std::make_shared<TCPHeader>())
+    , protocol_version_(0)
+    , live_sequence_number_(0)
+    , first_sequence_number_(0)
+    , highest_sequence_number_(0)
+    , connection_sequenced_messages_(0)
+    , missed_messages_before_connection_(0)
+    , reported_missed_messages_(0)
+    , received_messages_(0)
+    , missed_messages_(0)
+    , last_sequence_number_(0)
+    , flow_control_policy_(flow_control_policy)
+    , flow_control_active_(false)
+    , credit_connection_(0)
+    , pending_credit_messages_(0)
+    , pending_credit_bytes_(0)
+    , credit_grant_in_progress_(false)
+    , stripe_reassembler_(stripe_reassembler)
+    , stripe_index_(stripe_index)
 {
 
 }
@@ -42,32 +75,60 @@ void SubscriberSessionImpl::start()
 
 void SubscriberSessionImpl::resolveEndpoint()
 {
-    asio::ip::tcp::resolver::query query(address_, std::to_string(port_));
-
     if (canceled_)
     {
         connectionFailedHandler();
         return;
     }
 
+    if (!resolved_endpoints_.empty() 
+            && (std::chrono::steady_clock::now() - resolved_endpoints_time_ < reconnection_policy_.resolve_cache_ttl))
+    {
+        connectToEndpoint();
+        return;
+    }
+
+    asio::ip::tcp::resolver::query query(address_, std::to_string(port_));
+
     resolver_.async_resolve(query,
             [me = shared_from_this()](system::error_code ec, 
             const asio::ip::tcp::resolver::iterator& resolved_endpoints)
             {
+                me->handler_statistics_->count(HandlerSource::SubscriberConnect);
                 if (ec)
                 {
                     std::cout << "SubscriberSession " << me->endpointToString() 
                         << ": Failed to resolve address: " << ec.message() << std::endl;
-                    me->connectionFailedHandler();
+                    if (me->resolved_endpoints_.empty())
+                    {
+                        me->connectionFailedHandler();
+                    }
+                    else
+                    {
+                        me->connectToEndpoint();
+                    }
+                    return;
                 }
-                else
+
+                // Loopback addresses are tried first, all others keep the
+                // resolver's order.
+                me->resolved_endpoints_.clear();
+                for (auto it = resolved_endpoints; it != asio::ip::tcp::resolver::iterator(); it++)
                 {
-                    me->connectToEndpoint(resolved_endpoints);
+                    me->resolved_endpoints_.push_back(it->endpoint());
                 }
+                std::stable_partition(me->resolved_endpoints_.begin(), me->resolved_endpoints_.end(),
+                        [](const asio::ip::tcp::endpoint& endpoint) -> bool
+                        {
+                            return endpoint.address().is_loopback();
+                        });
+                me->resolved_endpoints_time_ = std::chrono::steady_clock::now();
+
+                me->connectToEndpoint();
             });
 }
 
-void SubscriberSessionImpl::connectToEndpoint(const asio::ip::tcp::resolver::iterator& resolved_endpoints)
+void SubscriberSessionImpl::connectToEndpoint()
 {
     if (canceled_)
     {
@@ -75,20 +136,10 @@ void SubscriberSessionImpl::connectToEndpoint(const asio::ip::tcp::resolver::ite
         return;
     }
 
-    auto endpoint_to_connect_to = resolved_endpoints->endpoint();
-    for (auto it = resolved_endpoints; it != asio::ip::tcp::resolver::iterator(); it++)
-    {
-        if (it->endpoint().address().is_loopback())
-        {
-            endpoint_to_connect_to = it->endpoint();
-            break;
-        }
-    }
-
-    endpoint_ = endpoint_to_connect_to;
-    data_socket_.async_connect(endpoint_to_connect_to, 
-            [me = shared_from_this()](system::error_code ec)
+    asio::async_connect(data_socket_, resolved_endpoints_,
+            [me = shared_from_this()](system::error_code ec, const asio::ip::tcp::endpoint& endpoint)
             {
+                me->handler_statistics_->count(HandlerSource::SubscriberConnect);
                 if (ec)
                 {
                     std::cout << "SubscriberSession " << me->endpointToString() 
@@ -98,8 +149,10 @@ void SubscriberSessionImpl::connectToEndpoint(const asio::ip::tcp::resolver::ite
                     }
                 else
                 {
+                    me->endpoint_ = endpoint;
                     std::cout << "SubscriberSession " << me->endpointToString()
                     << ": Successfully connected to publisher " << me->endpointToString() << std::endl;
+                    STPS_PROBE2(subscriber_session_connect, me.get(), me->remoteEndpointToString().c_str());
                     {
                         system::error_code nodelay_ec;
                         me->data_socket_.set_option(asio::ip::tcp::no_delay(true), nodelay_ec);
@@ -125,7 +178,7 @@ void SubscriberSessionImpl::sendProtokolHandshakeRequest()
     std::cout << "SubscriberSession " << endpointToString() 
         << ": Sending ProtocolHandshakeRequest.\n";
 
-    std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>();
+    std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
     buffer->resize(sizeof(TCPHeader) + sizeof(ProtocolHandshakeMessage));
 
     TCPHeader* header = reinterpret_cast<TCPHeader*>(buffer->data());
@@ -133,14 +186,26 @@ void SubscriberSessionImpl::sendProtokolHandshakeRequest()
     header->type = MessageContentType::ProtocolHandshake;
     header->reserved = 0;
     header->data_size = htole64(sizeof(ProtocolHandshakeMessage));
+    header->sequence_number = 0;
 
     ProtocolHandshakeMessage* handshake_message = 
         reinterpret_cast<ProtocolHandshakeMessage*>(&(buffer->operator[](sizeof(TCPHeader))));
-    handshake_message->protocol_version = 0;
+    handshake_message->protocol_version = kProtocolVersion;
+    handshake_message->credit_window_messages = htole64(flow_control_policy_.window_messages);
+    handshake_message->credit_window_bytes = htole64(flow_control_policy_.window_bytes);
+    handshake_message->downsampling_every_nth = htole64(downsampling_policy_.every_nth);
+    handshake_message->downsampling_interval_us = htole64(static_cast<uint64_t>(
+                std::max<int64_t>(downsampling_policy_.min_interval.count(), 0)));
+    if (stripe_reassembler_)
+    {
+        handshake_message->stripe_index = htole32(static_cast<uint32_t>(stripe_index_));
+        handshake_message->stripe_count = htole32(static_cast<uint32_t>(stripe_reassembler_->getStripeCount()));
+    }
 
     asio::async_write(data_socket_, asio::buffer(*buffer), data_strand_.wrap(
                 [me = shared_from_this(), buffer](system::error_code ec, std::size_t)
                 {
+                    me->handler_statistics_->count(HandlerSource::SubscriberConnect);
                     if (ec)
                     {
                         std::cout << "SubscriberSession " << me->endpointToString() 
@@ -159,6 +224,10 @@ void SubscriberSessionImpl::connectionFailedHandler()
         data_socket_.close(ec);
     }
 
+    // The other stripes must not wait for the frames of this one
+    if (stripe_reassembler_)
+        stripe_reassembler_->stripeDisconnected(stripe_index_);
+
     if (!canceled_ && (retries_left_ < 0 || retries_left_ > 0))
     {
         if (retries_left_ > 0)
@@ -166,8 +235,15 @@ void SubscriberSessionImpl::connectionFailedHandler()
             retries_left_--;
         }
 
+        const std::chrono::milliseconds delay = nextReconnectionDelay();
+        STPS_PROBE3(subscriber_reconnect, this, reconnection_attempt_, delay.count());
+        std::cout << "SubscriberSession " << endpointToString() 
+            << ": Reconnecting in " << delay.count() << " ms." << std::endl;
+
+        retry_timer_.expires_after(delay);
         retry_timer_.async_wait([me = shared_from_this()](system::error_code ec)
                 {
+                    me->handler_statistics_->count(HandlerSource::Timer);
                     if (ec)
                     {
                         std::cout << "SubscriberSession " << me->endpointToString() 
@@ -179,10 +255,34 @@ void SubscriberSessionImpl::connectionFailedHandler()
     }
     else
     {
+        STPS_PROBE1(subscriber_session_close, this);
         session_closed_handler_(shared_from_this());
     }
 }
 
+std::chrono::milliseconds SubscriberSessionImpl::nextReconnectionDelay()
+{
+    const int attempt = ++reconnection_attempt_;
+    if (attempt == 1)
+    {
+        return reconnection_policy_.first_retry_delay;
+    }
+
+    const double max_delay_ms = static_cast<double>(reconnection_policy_.max_delay.count());
+    const double exponential_delay_ms = static_cast<double>(reconnection_policy_.base_delay.count())
+        * std::pow(reconnection_policy_.multiplier, std::min(attempt - 2, 64));
+    double delay_ms = std::min(exponential_delay_ms, max_delay_ms);
+
+    const double jitter = std::min(std::max(reconnection_policy_.jitter, 0.0), 1.0);
+    if (jitter > 0.0)
+    {
+        std::uniform_real_distribution<double> jitter_distribution(1.0 - jitter, 1.0);
+        delay_ms *= jitter_distribution(jitter_engine_);
+    }
+
+    return std::chrono::milliseconds(static_cast<int64_t>(delay_ms));
+}
+
 void SubscriberSessionImpl::readHeaderLength()
 {
     if (canceled_)
@@ -191,13 +291,15 @@ void SubscriberSessionImpl::readHeaderLength()
         return;
     }
     
-    std::shared_ptr<TCPHeader> header = std::make_shared<TCPHeader>();
+    *receive_header_ = TCPHeader();
+    const std::shared_ptr<TCPHeader>& header = receive_header_;
 
     asio::async_read(data_socket_,
             asio::buffer(&(header->header_size), sizeof(header->header_size)),
             asio::transfer_at_least(sizeof(header->header_size)),
-            data_strand_.wrap([me = shared_from_this(), header](system::error_code ec, std::size_t)
+            data_strand_.wrap(withHandlerMemory(read_handler_memory_, [me = shared_from_this(), header](system::error_code ec, std::size_t)
                 {
+                    me->handler_statistics_->count(HandlerSource::SubscriberRead);
                     if (ec)
                     {
                         std::cout << "SubscriberSession " << me->endpointToString() 
@@ -206,7 +308,7 @@ void SubscriberSessionImpl::readHeaderLength()
                         return;
                     }
                     me->readHeaderContent(header);
-                }));
+                })));
 }
 
 void SubscriberSessionImpl::readHeaderContent(const std::shared_ptr<TCPHeader>& header)
@@ -231,13 +333,14 @@ void SubscriberSessionImpl::readHeaderContent(const std::shared_ptr<TCPHeader>&
     const uint16_t bytes_to_read_from_socket = 
         std::min(remote_header_size, my_header_size) - sizeof(header->header_size);
     const uint16_t bytes_to_discard_from_socket = 
-        (remote_header_size < my_header_size ? (remote_header_size - my_header_size) : 0);
+        (remote_header_size > my_header_size ? (remote_header_size - my_header_size) : 0);
 
     asio::async_read(data_socket_, 
             asio::buffer(&reinterpret_cast<char*>(header.get())[sizeof(header->header_size)], bytes_to_read_from_socket),
             asio::transfer_at_least(bytes_to_read_from_socket),
-            data_strand_.wrap([me = shared_from_this(), header, bytes_to_discard_from_socket](system::error_code ec, std::size_t)
+            data_strand_.wrap(withHandlerMemory(read_handler_memory_, [me = shared_from_this(), header, bytes_to_discard_from_socket](system::error_code ec, std::size_t)
                     {
+                        me->handler_statistics_->count(HandlerSource::SubscriberRead);
                         if (ec)
                         {
                             std::cout << "SubscriberSession " << me->endpointToString()
@@ -245,10 +348,6 @@ void SubscriberSessionImpl::readHeaderContent(const std::shared_ptr<TCPHeader>&
                             me->connectionFailedHandler();
                             return;
                         }
-                        
-                        std::cout << "SubscriberSession " << me->endpointToString() 
-                        << ": Received header content: " << "data_size: " 
-                        << std::to_string(le64toh(header->data_size));
 
                         if (bytes_to_discard_from_socket > 0)
                         {
@@ -259,7 +358,7 @@ void SubscriberSessionImpl::readHeaderContent(const std::shared_ptr<TCPHeader>&
                         {
                             me->readPayload(header);
                         }
-                    }));
+                    })));
 }
 
 void SubscriberSessionImpl::discardDataBetweenHeaderAndPayload(const std::shared_ptr<TCPHeader>& header, 
@@ -271,17 +370,14 @@ void SubscriberSessionImpl::discardDataBetweenHeaderAndPayload(const std::shared
         return;
     }
     
-    std::vector<char> data_to_discard;
-    data_to_discard.resize(bytes_to_discard);
+    discard_buffer_.resize(bytes_to_discard);
 
-    std::cout << "SubscriberSession " << endpointToString() << ": Discarding " 
-        << std::to_string(bytes_to_discard) << " bytes after the header.\n";
-    
     asio::async_read(data_socket_,
-            asio::buffer(data_to_discard.data(), bytes_to_discard),
+            asio::buffer(discard_buffer_.data(), bytes_to_discard),
             asio::transfer_at_least(bytes_to_discard),
-            data_strand_.wrap([me = shared_from_this(), header](system::error_code ec, std::size_t)
+            data_strand_.wrap(withHandlerMemory(read_handler_memory_, [me = shared_from_this(), header](system::error_code ec, std::size_t)
                 {
+                    me->handler_statistics_->count(HandlerSource::SubscriberRead);
                     if (ec)
                     {
                         std::cout << "SubscriberSession " << me->endpointToString()
@@ -292,7 +388,7 @@ void SubscriberSessionImpl::discardDataBetweenHeaderAndPayload(const std::shared
                         return;
                     }
                     me->readPayload(header);
-                }));
+                })));
 }
 
 void SubscriberSessionImpl::readPayload(const std::shared_ptr<TCPHeader>& header)
@@ -311,20 +407,33 @@ void SubscriberSessionImpl::readPayload(const std::shared_ptr<TCPHeader>& header
         return;
     }
 
-    std::shared_ptr<std::vector<char>> data_buffer = get_buffer_handler_();
+    std::shared_ptr<Buffer> data_buffer = get_buffer_handler_();
 
-    if (data_buffer->capacity() < le64toh(header->data_size))
+    try
     {
-        data_buffer->reserve(static_cast<size_t>(le64toh(header->data_size) * 1.1));
-    }
+        if (data_buffer->capacity() < le64toh(header->data_size))
+        {
+            data_buffer->reserve(static_cast<size_t>(le64toh(header->data_size) * 1.1));
+        }
 
-    data_buffer->resize(le64toh(header->data_size));
+        data_buffer->resize(le64toh(header->data_size));
+    }
+    catch (const std::bad_alloc&)
+    {
+        // The buffer memory budget is exhausted. The frame is skipped, the
+        // gap in the sequence numbers counts it as missed.
+        const uint64_t frame_size = (header->type == MessageContentType::RegularPayload)
+            ? le16toh(header->header_size) + le64toh(header->data_size) : 0;
+        discardPayload(le64toh(header->data_size), frame_size);
+        return;
+    }
 
     asio::async_read(data_socket_,
             asio::buffer(data_buffer->data(), le64toh(header->data_size)),
             asio::transfer_at_least(le64toh(header->data_size)),
-            data_strand_.wrap([me = shared_from_this(), header, data_buffer](system::error_code ec, std::size_t)
+            data_strand_.wrap(withHandlerMemory(read_handler_memory_, [me = shared_from_this(), header, data_buffer](system::error_code ec, std::size_t)
                 {
+                    me->handler_statistics_->count(HandlerSource::SubscriberRead);
                     if (ec)
                     {
                         std::cout << "SubscriberSession " << me->endpointToString() 
@@ -334,27 +443,59 @@ void SubscriberSessionImpl::readPayload(const std::shared_ptr<TCPHeader>& header
                     }
 
                     me->retries_left_ = me->max_reconnection_attempts_;
+                    me->reconnection_attempt_ = 0;
 
                     if (header->type == MessageContentType::ProtocolHandshake)
                     {
                         ProtocolHandshakeMessage handshake_message;
                         size_t bytes_to_copy = std::min(data_buffer->size(), sizeof(ProtocolHandshakeMessage));
                         std::memcpy(&handshake_message, data_buffer->data(), bytes_to_copy);
+                        STPS_PROBE2(subscriber_handshake, me.get(), handshake_message.protocol_version);
+
+                        // A new connection may be to a restarted publisher
+                        me->protocol_version_ = std::min(handshake_message.protocol_version, kProtocolVersion);
+                        me->missed_messages_before_connection_ = me->missed_messages_;
+                        me->live_sequence_number_ = (me->protocol_version_ >= 4)
+                            ? le64toh(handshake_message.next_sequence_number) : 0;
+                        me->first_sequence_number_ = 0;
+                        me->highest_sequence_number_ = 0;
+                        me->connection_sequenced_messages_ = 0;
+                        me->flow_control_active_ = (me->protocol_version_ >= 2)
+                            && ((me->flow_control_policy_.window_messages > 0) 
+                                    || (me->flow_control_policy_.window_bytes > 0));
+                        me->credit_connection_++;
+                        me->pending_credit_messages_ = 0;
+                        me->pending_credit_bytes_ = 0;
+                        if (me->stripe_reassembler_)
+                        {
+                            me->stripe_reassembler_->stripeConnected(me->stripe_index_, (me->protocol_version_ >= 4)
+                                    ? le64toh(handshake_message.next_sequence_number) : 0);
+                        }
                         std::cout << "SubscriberSession " << me->endpointToString() << 
                         ": Received Handshake message. Using Protocol Version v" 
                         << std::to_string(handshake_message.protocol_version) << std::endl;
                     }
                     else if (header->type == MessageContentType::RegularPayload)
                     {
-                        me->data_strand_.post([me, data_buffer, header]()
+                        STPS_TRACE(SubscriberFrameRead, data_buffer.get(), me.get(), data_buffer->size());
+                        STPS_PROBE2(subscriber_frame_received, me.get(), data_buffer->size());
+                        const uint64_t missed_messages = me->trackSequenceNumber(le64toh(header->sequence_number));
+                        const std::shared_ptr<void> credit 
+                            = me->createFrameCredit(le16toh(header->header_size) + data_buffer->size());
+                        // The callback side does not know the session, so the
+                        // callback queue is identified by the buffer only
+                        STPS_TRACE(SubscriberStrandPost, data_buffer.get(), nullptr, data_buffer->size());
+                        me->data_strand_.post(withHandlerMemory(me->callback_handler_memory_,
+                                [me, data_buffer, header, missed_messages, credit]()
                                 {
+                                    me->handler_statistics_->count(HandlerSource::SubscriberCallback);
                                     if (me->canceled_)
                                     {
                                         me->connectionFailedHandler();
                                         return;
                                     }
-                                    me->synchronous_callback_(data_buffer, header);
-                                });
+                                    me->synchronous_callback_(data_buffer, header, missed_messages, credit);
+                                }));
                     }
                     else
                     {
@@ -363,15 +504,178 @@ void SubscriberSessionImpl::readPayload(const std::shared_ptr<TCPHeader>& header
                             << std::to_string(static_cast<int>(header->type)) << std::endl;
                     }
 
-                    me->data_strand_.post([me]()
+                    // The read has released its handler memory
+                    me->data_strand_.post(withHandlerMemory(me->read_handler_memory_, [me]()
                             {
+                                me->handler_statistics_->count(HandlerSource::SubscriberRead);
                                 me->readHeaderLength();
-                            });
+                            }));
+                })));
+}
+
+void SubscriberSessionImpl::discardPayload(uint64_t bytes_to_discard, uint64_t frame_size)
+{
+    if (canceled_)
+    {
+        connectionFailedHandler();
+        return;
+    }
+
+    if (bytes_to_discard == 0)
+    {
+        // The publisher has spent credit on the frame as well
+        if (frame_size > 0) grantCredit(frame_size);
+        readHeaderLength();
+        return;
+    }
+
+    // Read in chunks, a frame may be far larger than the discard buffer
+    discard_buffer_.resize(static_cast<size_t>(std::min<uint64_t>(bytes_to_discard, 64 * 1024)));
+
+    asio::async_read(data_socket_,
+            asio::buffer(discard_buffer_.data(), discard_buffer_.size()),
+            asio::transfer_at_least(discard_buffer_.size()),
+            data_strand_.wrap(withHandlerMemory(read_handler_memory_, [me = shared_from_this(), bytes_to_discard, frame_size](system::error_code ec, std::size_t bytes_read)
+                {
+                    me->handler_statistics_->count(HandlerSource::SubscriberRead);
+                    if (ec)
+                    {
+                        std::cout << "SubscriberSession " << me->endpointToString()
+                        << ": Error discarding payload: " << ec.message() << std::endl;
+                        me->connectionFailedHandler();
+                        return;
+                    }
+                    me->discardPayload(bytes_to_discard - bytes_read, frame_size);
+                })));
+}
+
+uint64_t SubscriberSessionImpl::trackSequenceNumber(uint64_t sequence_number)
+{
+    received_messages_.store(received_messages_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if ((protocol_version_ < 1) || (sequence_number == 0)) return 0;
+
+    // The replay of a keyed late joiner cache has only the latest frame per
+    // key, the sequence numbers in between were not missed. The tracking
+    // starts with the first live frame.
+    if (sequence_number < live_sequence_number_)
+    {
+        last_sequence_number_.store(sequence_number, std::memory_order_relaxed);
+        return 0;
+    }
+
+    if (connection_sequenced_messages_ == 0)
+    {
+        first_sequence_number_ = sequence_number;
+        highest_sequence_number_ = sequence_number;
+    }
+    else if (sequence_number > highest_sequence_number_)
+    {
+        highest_sequence_number_ = sequence_number;
+    }
+    else if (sequence_number < first_sequence_number_)
+    {
+        first_sequence_number_ = sequence_number;
+    }
+    connection_sequenced_messages_++;
+
+    const uint64_t expected = highest_sequence_number_ - first_sequence_number_ + 1;
+    const uint64_t connection_missed = (expected > connection_sequenced_messages_ 
+            ? expected - connection_sequenced_messages_ : 0);
+    const uint64_t missed_messages = missed_messages_before_connection_ + connection_missed;
+    missed_messages_.store(missed_messages, std::memory_order_relaxed);
+    last_sequence_number_.store(sequence_number, std::memory_order_relaxed);
+
+    // A frame arriving late fills a gap, so the missed messages may go down
+    // again. Only report what exceeds everything reported so far, a report
+    // cannot be taken back.
+    const uint64_t newly_missed = (missed_messages > reported_missed_messages_
+            ? missed_messages - reported_missed_messages_ : 0);
+    reported_missed_messages_ = std::max(reported_missed_messages_, missed_messages);
+    return newly_missed;
+}
+
+std::shared_ptr<void> SubscriberSessionImpl::createFrameCredit(uint64_t frame_size)
+{
+    if (!flow_control_active_) return nullptr;
+
+    // The deleter runs wherever the message is consumed or dropped
+    return std::shared_ptr<void>(nullptr, 
+            [weak_me = std::weak_ptr<SubscriberSessionImpl>(shared_from_this()), 
+             connection = credit_connection_, frame_size](void*)
+            {
+                const auto me = weak_me.lock();
+                if (!me) return;
+                me->data_strand_.dispatch([me, connection, frame_size]()
+                        {
+                            if (me->credit_connection_ == connection) me->grantCredit(frame_size);
+                        });
+            });
+}
+
+void SubscriberSessionImpl::grantCredit(uint64_t frame_size)
+{
+    if (!flow_control_active_) return;
+
+    pending_credit_messages_++;
+    pending_credit_bytes_ += frame_size;
+    sendCreditGrant();
+}
+
+void SubscriberSessionImpl::sendCreditGrant()
+{
+    if (credit_grant_in_progress_ || canceled_) return;
+
+    // Granting a quarter of a window at a time keeps the publisher busy while
+    // the grant is on its way
+    const uint64_t message_threshold = std::max<uint64_t>(flow_control_policy_.window_messages / 4, 1);
+    const uint64_t byte_threshold = std::max<uint64_t>(flow_control_policy_.window_bytes / 4, 1);
+    const bool messages_due = (flow_control_policy_.window_messages > 0) 
+        && (pending_credit_messages_ >= message_threshold);
+    const bool bytes_due = (flow_control_policy_.window_bytes > 0) 
+        && (pending_credit_bytes_ >= byte_threshold);
+    if (!messages_due && !bytes_due) return;
+
+    credit_grant_buffer_.resize(sizeof(TCPHeader) + sizeof(CreditGrantMessage));
+
+    TCPHeader* header = reinterpret_cast<TCPHeader*>(credit_grant_buffer_.data());
+    *header = TCPHeader();
+    header->header_size = htole16(sizeof(TCPHeader));
+    header->type = MessageContentType::CreditGrant;
+    header->data_size = htole64(sizeof(CreditGrantMessage));
+
+    CreditGrantMessage* credit_grant = 
+        reinterpret_cast<CreditGrantMessage*>(&credit_grant_buffer_[sizeof(TCPHeader)]);
+    credit_grant->messages = htole64(pending_credit_messages_);
+    credit_grant->bytes = htole64(pending_credit_bytes_);
+
+    pending_credit_messages_ = 0;
+    pending_credit_bytes_ = 0;
+    credit_grant_in_progress_ = true;
+
+    // Errors are left to the reading side, which reconnects
+    asio::async_write(data_socket_, asio::buffer(credit_grant_buffer_), data_strand_.wrap(
+                [me = shared_from_this()](system::error_code ec, std::size_t)
+                {
+                    me->handler_statistics_->count(HandlerSource::SubscriberRead);
+                    me->credit_grant_in_progress_ = false;
+                    if (ec) return;
+                    me->sendCreditGrant();
                 }));
 }
 
-void SubscriberSessionImpl::setSynchronousCallback(const std::function<void(const std::shared_ptr<std::vector<char>>&, 
-            const std::shared_ptr<TCPHeader>&)>& callback)
+SubscriberSessionStatistics SubscriberSessionImpl::getStatistics() const
+{
+    SubscriberSessionStatistics statistics;
+    statistics.received_messages = received_messages_.load(std::memory_order_relaxed);
+    statistics.missed_messages = missed_messages_.load(std::memory_order_relaxed);
+    statistics.last_sequence_number = last_sequence_number_.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+void SubscriberSessionImpl::setSynchronousCallback(const std::function<void(const std::shared_ptr<Buffer>&, 
+            const std::shared_ptr<TCPHeader>&, uint64_t missed_messages,
+            const std::shared_ptr<void>& credit)>& callback)
 {
     if (canceled_) return;
     data_strand_.post([me = shared_from_this(), callback]()
@@ -1,13 +1,24 @@
 #pragma once
 
+#include <stps/buffer.h>
+#include <stps/handler_memory.h>
 #include <stps/tcp_header.h>
+#include <stps/executor/handler_statistics.h>
+#include <stps/subscriber/downsampling_policy.h>
+#include <stps/subscriber/flow_control_policy.h>
+#include <stps/subscriber/reconnection_policy.h>
+#include <stps/subscriber/stripe_reassembler.h>
+#include <stps/subscriber/subscriber_session.h>
+#include <atomic>
+#include <chrono>
+#include <random>
 #include <thread>
 #include <string>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <stps/boost_asio.h>
 #include <boost/asio/steady_timer.hpp>
-#include <boost/asio.hpp>
 using namespace boost;
 namespace stps
 {
@@ -15,8 +26,13 @@ class SubscriberSessionImpl : public std::enable_shared_from_this<SubscriberSess
 {
     public:
         SubscriberSessionImpl(const std::shared_ptr<asio::io_service>& io_service,
+                const std::shared_ptr<HandlerStatistics>& handler_statistics,
                 const std::string& address, uint16_t port, int max_reconnection_attempts,
-                const std::function<std::shared_ptr<std::vector<char>>()>& get_buffer_handler,
+                const ReconnectionPolicy& reconnection_policy,
+                const FlowControlPolicy& flow_control_policy,
+                const DownsamplingPolicy& downsampling_policy,
+                const std::shared_ptr<StripeReassembler>& stripe_reassembler, size_t stripe_index,
+                const std::function<std::shared_ptr<Buffer>()>& get_buffer_handler,
                 const std::function<void(const std::shared_ptr<SubscriberSessionImpl>&)>& session_closed_handler);
 
         SubscriberSessionImpl(const SubscriberSessionImpl&) = delete;
@@ -26,7 +42,12 @@ class SubscriberSessionImpl : public std::enable_shared_from_this<SubscriberSess
         ~SubscriberSessionImpl();
         void start();
 
-        void setSynchronousCallback(const std::function<void(const std::shared_ptr<std::vector<char>>&, const std::shared_ptr<TCPHeader>&)>& callback);
+        // missed_messages: missed messages detected with this frame
+        // credit: grants the flow control credit of the frame once the last
+        // copy is released, keep it until the message has been consumed
+        void setSynchronousCallback(const std::function<void(const std::shared_ptr<Buffer>&, 
+                    const std::shared_ptr<TCPHeader>&, uint64_t missed_messages,
+                    const std::shared_ptr<void>& credit)>& callback);
 
         std::string getAddress() const;
 
@@ -36,30 +57,88 @@ class SubscriberSessionImpl : public std::enable_shared_from_this<SubscriberSess
 
         bool isConnected() const;
 
+        SubscriberSessionStatistics getStatistics() const;
+
         std::string remoteEndpointToString() const;
         std::string localEndpointToString() const;
         std::string endpointToString() const;
 
     private:
+        const std::shared_ptr<HandlerStatistics> handler_statistics_;
         std::string address_;
         uint16_t port_;
         asio::ip::tcp::resolver resolver_;
         asio::ip::tcp::endpoint endpoint_;
+        std::vector<asio::ip::tcp::endpoint> resolved_endpoints_;
+        std::chrono::steady_clock::time_point resolved_endpoints_time_;
         int max_reconnection_attempts_;
         int retries_left_;
+        const ReconnectionPolicy reconnection_policy_;
+        const DownsamplingPolicy downsampling_policy_;
+        int reconnection_attempt_;
+        std::minstd_rand jitter_engine_;
         asio::steady_timer retry_timer_;
         std::atomic<bool> canceled_;
 
         asio::ip::tcp::socket data_socket_;
         asio::io_service::strand data_strand_;
 
-        const std::function<std::shared_ptr<std::vector<char>>()> get_buffer_handler_;
+        const std::function<std::shared_ptr<Buffer>()> get_buffer_handler_;
         const std::function<void(const std::shared_ptr<SubscriberSessionImpl>&)> session_closed_handler_;
-        std::function<void(const std::shared_ptr<std::vector<char>>&, const std::shared_ptr<TCPHeader>&)> synchronous_callback_;
+        std::function<void(const std::shared_ptr<Buffer>&, const std::shared_ptr<TCPHeader>&, 
+                uint64_t, const std::shared_ptr<void>&)> synchronous_callback_;
+
+        // Reused for every received frame, so reading does not allocate.
+        // Only accessed from the data strand, the callback for a frame is
+        // always executed before the next header is read.
+        const std::shared_ptr<TCPHeader> receive_header_;
+        std::vector<char> discard_buffer_;
+        // One read is in flight at a time. Callbacks may queue up on the
+        // strand, those beyond the first are allocated.
+        HandlerMemory read_handler_memory_;
+        HandlerMemory callback_handler_memory_;
+
+        // Sequence tracking of the current connection, only accessed from the
+        // data strand. Frames of several sending threads may arrive slightly
+        // out of order, so missed messages are derived from the range of
+        // sequence numbers seen and the number of frames received.
+        uint8_t protocol_version_;
+        // The publisher's next sequence number at the handshake, 0 if it does
+        // not send one. Lower ones are the late joiner cache replay.
+        uint64_t live_sequence_number_;
+        uint64_t first_sequence_number_;
+        uint64_t highest_sequence_number_;
+        uint64_t connection_sequenced_messages_;
+        uint64_t missed_messages_before_connection_;
+        // Highest missed_messages_ reported to a callback
+        uint64_t reported_missed_messages_;
+
+        // Written from the data strand only
+        std::atomic<uint64_t> received_messages_;
+        std::atomic<uint64_t> missed_messages_;
+        std::atomic<uint64_t> last_sequence_number_;
+
+        // Credit of consumed frames not granted to the publisher yet. Only
+        // accessed from the data strand.
+        const FlowControlPolicy flow_control_policy_;
+        bool flow_control_active_;
+        // Counts the handshakes, credit of frames of an earlier connection
+        // is not granted
+        uint64_t credit_connection_;
+        uint64_t pending_credit_messages_;
+        uint64_t pending_credit_bytes_;
+        bool credit_grant_in_progress_;
+        std::vector<char> credit_grant_buffer_;
+
+        // nullptr unless the connection is one stripe of a striped session
+        const std::shared_ptr<StripeReassembler> stripe_reassembler_;
+        const size_t stripe_index_;
 
         void resolveEndpoint();
 
-        void connectToEndpoint(const asio::ip::tcp::resolver::iterator& resolved_endpoints);
+        void connectToEndpoint();
+
+        std::chrono::milliseconds nextReconnectionDelay();
 
         void sendProtokolHandshakeRequest();
 
@@ -73,6 +152,20 @@ class SubscriberSessionImpl : public std::enable_shared_from_this<SubscriberSess
 
         void readPayload(const std::shared_ptr<TCPHeader>& header);
 
+        // Skips a payload that there is no buffer memory for and grants the
+        // credit of the frame afterwards, frame_size 0 grants none
+        void discardPayload(uint64_t bytes_to_discard, uint64_t frame_size);
+
+        // Returns the missed messages to report with this frame
+        uint64_t trackSequenceNumber(uint64_t sequence_number);
+
+        // nullptr without flow control
+        std::shared_ptr<void> createFrameCredit(uint64_t frame_size);
+
+        void grantCredit(uint64_t frame_size);
+
+        void sendCreditGrant();
+
 
 
 
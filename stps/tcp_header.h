@@ -8,7 +8,8 @@ namespace stps
 enum class MessageContentType : uint8_t
 {
 	RegularPayload = 0,
-	ProtocolHandshake = 1
+	ProtocolHandshake = 1,
+	CreditGrant = 2
 };
 
 #pragma pack(push,1)
@@ -19,6 +20,10 @@ struct TCPHeader
 	MessageContentType type = MessageContentType::RegularPayload;
 	uint8_t reserved = 0;
 	uint64_t data_size = 0;
+
+	// Since protocol version 1. Numbers the regular payload frames of a
+	// publisher starting at 1; 0 if the frame has no sequence number.
+	uint64_t sequence_number = 0;
 };
 
 #pragma pack(pop)
@@ -0,0 +1,46 @@
+#pragma once
+
+// USDT (SystemTap / bpftrace) probes, provider "stps".
+//
+// If <sys/sdt.h> is available (systemtap-sdt-dev), every probe compiles to a
+// single nop plus an ELF note. Nothing happens until a tracer attaches, so
+// the probes can stay in production builds. Define STPS_DISABLE_PROBES to
+// leave them out entirely. Without <sys/sdt.h> they compile to nothing.
+//
+// List them with:  bpftrace -l 'usdt:/path/to/binary:stps:*'
+// Example:         bpftrace -e 'usdt:./app:stps:publisher_frame_sent { @bytes = hist(arg1); }'
+//
+// Probe                       Arguments
+// publisher_session_accept    session, remote endpoint (char*)
+// publisher_session_close     session, remote endpoint (char*)
+// publisher_handshake         session, protocol version
+// publisher_frame_sent        session, frame size
+// publisher_drop              session, frame size, dropped messages of the session
+// publisher_pool_allocate     publisher, requested size
+// publisher_pool_miss         publisher
+// subscriber_session_connect  session, remote endpoint (char*)
+// subscriber_session_close    session
+// subscriber_handshake        session, protocol version
+// subscriber_frame_received   session, payload size
+// subscriber_reconnect        session, attempt, delay in ms
+// subscriber_pool_allocate    subscriber
+// subscriber_pool_miss        subscriber
+//
+// Buffer pool hits are pool_allocate minus pool_miss.
+
+#if !defined(STPS_DISABLE_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define STPS_HAS_PROBES 1
+#endif
+#endif
+
+#ifdef STPS_HAS_PROBES
+#define STPS_PROBE1(name, a1)             DTRACE_PROBE1(stps, name, a1)
+#define STPS_PROBE2(name, a1, a2)         DTRACE_PROBE2(stps, name, a1, a2)
+#define STPS_PROBE3(name, a1, a2, a3)     DTRACE_PROBE3(stps, name, a1, a2, a3)
+#else
+#define STPS_PROBE1(name, a1)             do {} while (0)
+#define STPS_PROBE2(name, a1, a2)         do {} while (0)
+#define STPS_PROBE3(name, a1, a2, a3)     do {} while (0)
+#endif
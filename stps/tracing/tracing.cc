@@ -0,0 +1,262 @@
+#include <stps/tracing/tracing.h>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace stps
+{
+namespace tracing
+{
+namespace detail
+{
+    std::atomic<bool> enabled(false);
+}
+
+namespace
+{
+    static_assert((kEventsPerThread & (kEventsPerThread - 1)) == 0,
+            "kEventsPerThread must be a power of two");
+
+    struct TraceRecord
+    {
+        int64_t timestamp_ns;
+        uintptr_t message;
+        uintptr_t context;
+        uint64_t size;
+        TraceEvent event;
+    };
+
+    // Written by the owning thread only. Readers use write_count_ to find the
+    // valid records.
+    struct ThreadTraceBuffer
+    {
+        ThreadTraceBuffer()
+            : thread_id_(static_cast<int64_t>(::syscall(SYS_gettid)))
+            , records_(new TraceRecord[kEventsPerThread])
+            , write_count_(0)
+            , cleared_count_(0)
+        {}
+
+        const int64_t thread_id_;
+        const std::unique_ptr<TraceRecord[]> records_;
+        std::atomic<uint64_t> write_count_;
+        std::atomic<uint64_t> cleared_count_;
+    };
+
+    struct TraceBufferRegistry
+    {
+        std::mutex mutex_;
+        std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers_;
+    };
+
+    TraceBufferRegistry& registry()
+    {
+        static TraceBufferRegistry trace_buffer_registry;
+        return trace_buffer_registry;
+    }
+
+    ThreadTraceBuffer& threadTraceBuffer()
+    {
+        // The registry keeps the buffer of a thread alive after it has exited
+        thread_local std::shared_ptr<ThreadTraceBuffer> thread_trace_buffer;
+        if (!thread_trace_buffer)
+        {
+            thread_trace_buffer = std::make_shared<ThreadTraceBuffer>();
+            std::lock_guard<std::mutex> registry_lock(registry().mutex_);
+            registry().buffers_.push_back(thread_trace_buffer);
+        }
+        return *thread_trace_buffer;
+    }
+
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void writeAddress(std::ostream& stream, uintptr_t address)
+    {
+        stream << "0x" << std::hex << address << std::dec;
+    }
+
+    // Common fields of one trace event. Chrome expects microseconds.
+    void writeEventStart(std::ostream& stream, bool& first, const char* name, const char* phase,
+            const ThreadTraceBuffer& buffer, const TraceRecord& record)
+    {
+        stream << (first ? "\n" : ",\n")
+            << "{\"name\":\"" << name << "\",\"cat\":\"stps\",\"ph\":\"" << phase
+            << "\",\"pid\":" << ::getpid() << ",\"tid\":" << buffer.thread_id_
+            << ",\"ts\":" << record.timestamp_ns / 1000 << "."
+            << std::setw(3) << std::setfill('0') << record.timestamp_ns % 1000 << std::setfill(' ');
+        first = false;
+    }
+
+    void writeAsyncId(std::ostream& stream, const TraceRecord& record)
+    {
+        stream << ",\"id\":\"";
+        writeAddress(stream, record.message);
+        stream << "-";
+        writeAddress(stream, record.context);
+        stream << "\"";
+    }
+
+    void writeArgs(std::ostream& stream, const TraceRecord& record)
+    {
+        stream << ",\"args\":{\"message\":\"";
+        writeAddress(stream, record.message);
+        stream << "\",\"context\":\"";
+        writeAddress(stream, record.context);
+        stream << "\",\"size\":" << record.size << "}}";
+    }
+
+    void writeAsyncEvent(std::ostream& stream, bool& first, const char* name, const char* phase,
+            const ThreadTraceBuffer& buffer, const TraceRecord& record)
+    {
+        writeEventStart(stream, first, name, phase, buffer, record);
+        writeAsyncId(stream, record);
+        writeArgs(stream, record);
+    }
+
+    void writeThreadEvent(std::ostream& stream, bool& first, const char* name, const char* phase,
+            const ThreadTraceBuffer& buffer, const TraceRecord& record)
+    {
+        writeEventStart(stream, first, name, phase, buffer, record);
+        if (phase[0] == 'i')
+            stream << ",\"s\":\"t\"";
+        writeArgs(stream, record);
+    }
+
+    void writeRecord(std::ostream& stream, bool& first, const ThreadTraceBuffer& buffer,
+            const TraceRecord& record)
+    {
+        switch (record.event)
+        {
+        case TraceEvent::PublisherSendBegin:
+            writeThreadEvent(stream, first, "Publisher::send", "B", buffer, record);
+            break;
+        case TraceEvent::PublisherSendEnd:
+            writeThreadEvent(stream, first, "Publisher::send", "E", buffer, record);
+            break;
+        case TraceEvent::PublisherEnqueue:
+            writeAsyncEvent(stream, first, "queued", "b", buffer, record);
+            break;
+        case TraceEvent::PublisherDrop:
+            writeAsyncEvent(stream, first, "queued", "e", buffer, record);
+            writeThreadEvent(stream, first, "dropped", "i", buffer, record);
+            break;
+        case TraceEvent::PublisherWriteStart:
+            writeAsyncEvent(stream, first, "queued", "e", buffer, record);
+            writeAsyncEvent(stream, first, "write", "b", buffer, record);
+            break;
+        case TraceEvent::PublisherWriteComplete:
+            writeAsyncEvent(stream, first, "write", "e", buffer, record);
+            break;
+        case TraceEvent::SubscriberFrameRead:
+            writeThreadEvent(stream, first, "frame received", "i", buffer, record);
+            break;
+        case TraceEvent::SubscriberStrandPost:
+            writeAsyncEvent(stream, first, "callback queue", "b", buffer, record);
+            break;
+        case TraceEvent::SubscriberCallbackDrop:
+            writeAsyncEvent(stream, first, "callback queue", "e", buffer, record);
+            writeThreadEvent(stream, first, "callback dropped", "i", buffer, record);
+            break;
+        case TraceEvent::SubscriberCallbackStart:
+            writeAsyncEvent(stream, first, "callback queue", "e", buffer, record);
+            writeThreadEvent(stream, first, "callback", "B", buffer, record);
+            break;
+        case TraceEvent::SubscriberCallbackEnd:
+            writeThreadEvent(stream, first, "callback", "E", buffer, record);
+            break;
+        }
+    }
+} // namespace
+
+void enable()
+{
+    detail::enabled = true;
+}
+
+void disable()
+{
+    detail::enabled = false;
+}
+
+void clear()
+{
+    std::lock_guard<std::mutex> registry_lock(registry().mutex_);
+    for (const auto& buffer : registry().buffers_)
+    {
+        buffer->cleared_count_ = buffer->write_count_.load();
+    }
+}
+
+void record(TraceEvent event, const void* message, const void* context, uint64_t size)
+{
+    ThreadTraceBuffer& buffer = threadTraceBuffer();
+    const uint64_t index = buffer.write_count_.load(std::memory_order_relaxed);
+
+    TraceRecord& trace_record = buffer.records_[index & (kEventsPerThread - 1)];
+    trace_record.timestamp_ns = nowNs();
+    trace_record.message = reinterpret_cast<uintptr_t>(message);
+    trace_record.context = reinterpret_cast<uintptr_t>(context);
+    trace_record.size = size;
+    trace_record.event = event;
+
+    buffer.write_count_.store(index + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(std::ostream& stream)
+{
+    std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> registry_lock(registry().mutex_);
+        buffers = registry().buffers_;
+    }
+
+    stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+
+    std::vector<TraceRecord> records;
+    for (const auto& buffer : buffers)
+    {
+        const uint64_t write_count = buffer->write_count_.load(std::memory_order_acquire);
+        uint64_t begin = std::max(buffer->cleared_count_.load(),
+                (write_count > kEventsPerThread ? write_count - kEventsPerThread : uint64_t(0)));
+
+        records.clear();
+        for (uint64_t i = begin; i < write_count; ++i)
+            records.push_back(buffer->records_[i & (kEventsPerThread - 1)]);
+
+        // The thread may have kept on writing and overwritten the oldest records
+        const uint64_t write_count_after_copy = buffer->write_count_.load(std::memory_order_acquire);
+        const uint64_t skip = (write_count_after_copy > begin + kEventsPerThread
+                ? std::min<uint64_t>(write_count_after_copy - kEventsPerThread - begin, records.size())
+                : 0);
+
+        for (size_t i = static_cast<size_t>(skip); i < records.size(); ++i)
+            writeRecord(stream, first, *buffer, records[i]);
+    }
+
+    stream << "\n]}\n";
+    return bool(stream);
+}
+
+bool writeChromeTrace(const std::string& file_name)
+{
+    std::ofstream trace_file(file_name);
+    if (!trace_file)
+        return false;
+    return writeChromeTrace(trace_file);
+}
+
+} // namespace tracing
+} // namespace stps
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <ostream>
+#include <string>
+
+// Per-message lifecycle tracing.
+//
+// The trace points are only compiled in if the library is built with
+// STPS_ENABLE_TRACING (CMake option of the same name). Even then, nothing is
+// recorded until tracing::enable() is called. Every thread records into its
+// own ring buffer of the last kEventsPerThread events, so recording takes
+// neither a lock nor (except for the first event of a thread) an allocation.
+//
+// writeChromeTrace() dumps the rings as Chrome trace event JSON that can be
+// opened with chrome://tracing or https://ui.perfetto.dev. A message shows up
+// as:
+//   Publisher:  "Publisher::send" slice on the sending thread, "queued" and
+//               "write" async slices per subscriber session
+//   Subscriber: "frame received" instant, "callback queue" async slice until
+//               the user callback starts, "callback" slice on the calling thread
+
+namespace stps
+{
+namespace tracing
+{
+    enum class TraceEvent : uint8_t
+    {
+        PublisherSendBegin,
+        PublisherSendEnd,
+        PublisherEnqueue,
+        PublisherDrop,
+        PublisherWriteStart,
+        PublisherWriteComplete,
+        SubscriberFrameRead,
+        SubscriberStrandPost,
+        SubscriberCallbackDrop,
+        SubscriberCallbackStart,
+        SubscriberCallbackEnd
+    };
+
+    constexpr size_t kEventsPerThread = 65536;
+
+    void enable();
+
+    void disable();
+
+    // Forgets all events recorded so far
+    void clear();
+
+    // Writes the recorded events of all threads. Events that are overwritten
+    // while writing are skipped.
+    bool writeChromeTrace(std::ostream& stream);
+
+    bool writeChromeTrace(const std::string& file_name);
+
+    // message identifies the message (the frame or payload buffer), context the
+    // publisher or subscriber session handling it
+    void record(TraceEvent event, const void* message, const void* context, uint64_t size);
+
+    namespace detail
+    {
+        extern std::atomic<bool> enabled;
+    }
+
+    inline bool isEnabled()
+    {
+        return detail::enabled.load(std::memory_order_relaxed);
+    }
+} // namespace tracing
+} // namespace stps
+
+#ifdef STPS_ENABLE_TRACING
+#define STPS_TRACE(event, message, context, size)                                          \
+    do                                                                                     \
+    {                                                                                      \
+        if (::stps::tracing::isEnabled())                                                  \
+            ::stps::tracing::record(::stps::tracing::TraceEvent::event, message, context, size); \
+    } while (0)
+#else
+#define STPS_TRACE(event, message, context, size) do {} while (0)
+#endif